@@ -0,0 +1,105 @@
+// In-process output checker versus the old `diff -w` subprocess path.
+//
+// Usage (from the repository root): ./bench/checker_bench [repetitions]
+
+#include "checker.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+
+using namespace std;
+namespace fs = std::filesystem;
+
+const string WORK_DIR = ".oj_cache/checker_bench";
+
+// Roughly `bytes` of numbers, a few per line. `noisy` adds the blank
+// variations that `diff -w` ignores (extra spaces, tabs, \r\n endings).
+static void writeOutput(const string &path, size_t bytes, bool noisy,
+                        bool corrupt_first, bool corrupt_last) {
+    mt19937 rng(12345), noise(777);
+    ofstream out(path, ios::binary);
+    size_t written = 0;
+    while (written < bytes) {
+        string line;
+        int count = 1 + rng() % 8;
+        for (int k = 0; k < count; k++) {
+            if (k)
+                line += noisy && noise() % 4 == 0 ? " \t " : " ";
+            line += to_string(rng() % 1000000007);
+        }
+        if ((written == 0 && corrupt_first) ||
+            (written + line.size() + 1 >= bytes && corrupt_last))
+            line.back() = line.back() == '0' ? '1' : '0';
+        line += noisy ? " \r\n" : "\n";
+        out << line;
+        written += line.size();
+    }
+}
+
+template <class F> static double timeMs(F f, int reps) {
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < reps; i++)
+        f();
+    auto end = chrono::steady_clock::now();
+    return chrono::duration<double, milli>(end - start).count() / reps;
+}
+
+int main(int argc, char *argv[]) {
+    int reps = argc > 1 ? stoi(argv[1]) : 5;
+    fs::create_directories(WORK_DIR);
+    string expected = WORK_DIR + "/expected.out";
+    string output = WORK_DIR + "/output.txt";
+    string errorlog = WORK_DIR + "/errorlog.txt";
+
+    cout << left << setw(10) << "size" << setw(16) << "case" << right
+         << setw(12) << "checker ms" << setw(12) << "diff ms" << setw(10)
+         << "speedup" << '\n';
+
+    for (size_t mb : {1, 8, 64}) {
+        size_t bytes = mb << 20;
+        writeOutput(expected, bytes, false, false, false);
+
+        struct Case {
+            const char *name;
+            bool noisy, corrupt_first, corrupt_last;
+        } cases[] = {{"identical", false, false, false},
+                     {"blank-noise", true, false, false},
+                     {"wrong-first", false, true, false},
+                     {"wrong-last", false, false, true}};
+
+        for (const Case &c : cases) {
+            writeOutput(output, bytes, c.noisy, c.corrupt_first,
+                        c.corrupt_last);
+
+            bool checker_equal = false;
+            double checker_ms = timeMs(
+                [&] { checker_equal = compareFiles(output, expected).equal; },
+                reps);
+
+            int diff_status = 0;
+            string command =
+                "diff -w " + output + " " + expected + " > " + errorlog;
+            double diff_ms = timeMs(
+                [&] { diff_status = system(command.c_str()); }, reps);
+
+            if (checker_equal != (diff_status == 0)) {
+                cerr << "Verdict mismatch on " << mb << " MB " << c.name
+                     << '\n';
+                return 1;
+            }
+            cout << left << setw(10) << (to_string(mb) + " MB")
+                 << setw(16) << c.name << right << fixed << setprecision(2)
+                 << setw(12) << checker_ms << setw(12) << diff_ms << setw(9)
+                 << diff_ms / checker_ms << "x\n";
+        }
+    }
+
+    fs::remove_all(WORK_DIR);
+    return 0;
+}
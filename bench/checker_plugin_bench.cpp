@@ -0,0 +1,145 @@
+// Special-judge checker throughput: the tolerance checker loaded as a plugin
+// into the judge, in a persistent checker host process (checker_mode
+// process), and as a fresh process per check, which is what an external
+// checker would cost. Also checks that all three give the same verdicts.
+//
+// Usage (from the repository root): ./bench/checker_plugin_bench [checks]
+
+#include "special_checker.h"
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <spawn.h>    // for posix_spawn
+#include <sys/wait.h> // for waitpid
+
+using namespace std;
+namespace fs = std::filesystem;
+
+const string WORK_DIR = ".oj_cache/checker_plugin_bench";
+const string CHECKER_SOURCE = "bench/tolerance_checker.cpp";
+// Numbers per output
+const int VALUES = 1000;
+
+// Check every output, returns the total milliseconds and the verdicts (1
+// accepted, 0 wrong, -1 error)
+static double checkAll(const vector<string> &outputs,
+                       const function<int(const string &)> &check,
+                       vector<int> &verdicts) {
+    verdicts.clear();
+    auto start = chrono::steady_clock::now();
+    for (const string &output : outputs)
+        verdicts.push_back(check(output));
+    auto end = chrono::steady_clock::now();
+    return chrono::duration<double, milli>(end - start).count();
+}
+
+static int verdictOf(const CompareResult &result) {
+    return result.error ? -1 : result.equal ? 1 : 0;
+}
+
+int main(int argc, char *argv[]) {
+    // This binary is also its own checker host and one-shot checker
+    if (argc == 4 && string(argv[1]) == "--checker-host")
+        return runCheckerHost(argv[2], stoi(argv[3]));
+    if (argc == 6 && string(argv[1]) == "--check-once") {
+        SpecialChecker checker(argv[2], false);
+        return verdictOf(checker.check(argv[3], argv[4], argv[5])) + 1;
+    }
+
+    int checks = argc > 1 ? stoi(argv[1]) : 500;
+    fs::create_directories(WORK_DIR);
+    string object = buildChecker(CHECKER_SOURCE);
+    if (object.empty()) {
+        cerr << "Could not build " << CHECKER_SOURCE << '\n';
+        return 1;
+    }
+
+    // One answer; outputs equal to it up to rounding, every tenth one off
+    mt19937 rng(2024);
+    uniform_real_distribution<double> value(-1e6, 1e6);
+    vector<double> values(VALUES);
+    string input = WORK_DIR + "/input.txt", answer = WORK_DIR + "/answer.txt";
+    ofstream(input) << VALUES << '\n';
+    {
+        ofstream out(answer);
+        out << setprecision(12);
+        for (double &v : values)
+            out << (v = value(rng)) << '\n';
+    }
+    vector<string> outputs;
+    for (int k = 0; k < checks; k++) {
+        string output = WORK_DIR + "/output" + to_string(k) + ".txt";
+        ofstream out(output);
+        out << setprecision(15);
+        for (int i = 0; i < VALUES; i++)
+            out << values[i] * (k % 10 == 9 && i == VALUES / 2 ? 1.001 : 1)
+                << '\n';
+        outputs.push_back(output);
+    }
+
+    SpecialChecker plugin(object, false);
+    SpecialChecker host(object, true);
+    if (!plugin.ok()) {
+        cerr << "Could not load " << object << '\n';
+        return 1;
+    }
+    vector<int> plugin_verdicts, host_verdicts, spawn_verdicts;
+    double plugin_ms = checkAll(
+        outputs,
+        [&](const string &output) {
+            return verdictOf(plugin.check(input, output, answer));
+        },
+        plugin_verdicts);
+    double host_ms = checkAll(
+        outputs,
+        [&](const string &output) {
+            return verdictOf(host.check(input, output, answer));
+        },
+        host_verdicts);
+    string self = fs::read_symlink("/proc/self/exe").string();
+    double spawn_ms = checkAll(
+        outputs,
+        [&](const string &output) {
+            vector<string> args = {self, "--check-once", object, input,
+                                   output, answer};
+            vector<char *> argv;
+            for (string &arg : args)
+                argv.push_back(&arg[0]);
+            argv.push_back(nullptr);
+            pid_t pid;
+            int status;
+            if (posix_spawn(&pid, self.c_str(), nullptr, nullptr,
+                            argv.data(), environ) != 0 ||
+                waitpid(pid, &status, 0) != pid || !WIFEXITED(status))
+                return -1;
+            return WEXITSTATUS(status) - 1;
+        },
+        spawn_verdicts);
+
+    cout << checks << " checks of " << VALUES << " numbers\n"
+         << left << setw(24) << "mode" << right << setw(12) << "total ms"
+         << setw(14) << "checks/s" << '\n';
+    auto row = [&](const string &mode, double ms) {
+        cout << left << setw(24) << mode << right << fixed << setprecision(1)
+             << setw(12) << ms << setw(14) << checks * 1000.0 / ms << '\n';
+    };
+    row("in-process plugin", plugin_ms);
+    row("checker host", host_ms);
+    row("process per check", spawn_ms);
+
+    bool same = plugin_verdicts == host_verdicts &&
+                plugin_verdicts == spawn_verdicts;
+    cout << (same ? "verdicts identical" : "VERDICTS DIFFER") << '\n';
+
+    error_code ec;
+    fs::remove_all(WORK_DIR, ec);
+    return same ? 0 : 1;
+}
@@ -0,0 +1,78 @@
+// Cold g++ versus the precompiled <bits/stdc++.h> path on the Submit/ corpus.
+//
+// Usage (from the repository root): ./bench/compile_bench [repetitions]
+
+#include "compile_cache.h"
+#include "compile_server.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+namespace fs = std::filesystem;
+
+const string FLAGS = "";
+const string OUTPUT = ".oj_cache/compile_bench_out";
+
+// Mean wall time of `reps` compiles of `source`, in milliseconds
+static double timeCompile(const string &source, const string &args, int reps) {
+    string command = CXX + " " + FLAGS + " " + args + " " + source + " -o " +
+                     OUTPUT + " 2>/dev/null";
+    double total = 0;
+    for (int i = 0; i < reps; i++) {
+        auto start = chrono::steady_clock::now();
+        if (system(command.c_str()) != 0)
+            return -1;
+        auto end = chrono::steady_clock::now();
+        total += chrono::duration<double, milli>(end - start).count();
+    }
+    return total / reps;
+}
+
+int main(int argc, char *argv[]) {
+    int reps = argc > 1 ? stoi(argv[1]) : 3;
+
+    auto pch_start = chrono::steady_clock::now();
+    string pch_args = precompiledHeaderArgs(FLAGS);
+    auto pch_end = chrono::steady_clock::now();
+    if (pch_args.empty()) {
+        cerr << "Could not build the precompiled header\n";
+        return 1;
+    }
+    cout << "PCH ready in "
+         << chrono::duration_cast<chrono::milliseconds>(pch_end - pch_start)
+                .count()
+         << " ms (" << pch_args << ")\n\n";
+
+    vector<string> sources;
+    for (const auto &entry : fs::directory_iterator("Submit"))
+        if (entry.path().extension() == ".cpp")
+            sources.push_back(entry.path().string());
+    sort(sources.begin(), sources.end());
+
+    cout << left << setw(28) << "source" << right << setw(12) << "cold ms"
+         << setw(12) << "pch ms" << setw(10) << "speedup" << '\n';
+    double cold_total = 0, pch_total = 0;
+    for (const string &source : sources) {
+        double cold = timeCompile(source, "", reps);
+        double pch = timeCompile(source, pch_args, reps);
+        cold_total += cold;
+        pch_total += pch;
+        cout << left << setw(28) << source << right << fixed
+             << setprecision(1) << setw(12) << cold << setw(12) << pch
+             << setw(9) << cold / pch << "x\n";
+    }
+    cout << left << setw(28) << "total" << right << setw(12) << cold_total
+         << setw(12) << pch_total << setw(9) << cold_total / pch_total
+         << "x\n";
+
+    error_code ec;
+    fs::remove(OUTPUT, ec);
+    return 0;
+}
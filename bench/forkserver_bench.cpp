@@ -0,0 +1,139 @@
+// Per-test process startup: exec'ing the participant for every test versus
+// forking one pre-initialized copy (--fork-server), on a problem with many
+// tiny tests. Also checks that both modes produce the same outputs.
+//
+// Usage (from the repository root): ./bench/forkserver_bench [tests]
+
+#include "compile_server.h"
+#include "runner.h"
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+namespace fs = std::filesystem;
+
+const string WORK_DIR = ".oj_cache/forkserver_bench";
+const string FLAGS = "-O2 -std=c++17";
+
+// Typical participant code: the whole standard library, iostreams, a
+// little static state
+const char *SOLUTION = R"(#include <bits/stdc++.h>
+using namespace std;
+static vector<long long> memo(1000, -1);
+int main() {
+    ios::sync_with_stdio(false);
+    long long a, b;
+    cin >> a >> b;
+    cout << a + b << '\n';
+    return 0;
+}
+)";
+
+static string readAll(const string &path) {
+    ifstream in(path, ios::binary);
+    stringstream buffer;
+    buffer << in.rdbuf();
+    return buffer.str();
+}
+
+// Runs every test, returns the total milliseconds and the outputs
+static double runAll(const string &binary, const vector<string> &inputs,
+                     ForkServer *server, vector<string> &outputs,
+                     int &failed) {
+    RunLimits limits;
+    limits.time_limit_ms = 1000;
+    limits.memory_limit_bytes = 256L << 20;
+    string output = WORK_DIR + "/output.txt";
+    outputs.clear();
+    failed = 0;
+
+    auto start = chrono::steady_clock::now();
+    for (const string &input : inputs) {
+        RunResult run =
+            runProcess(binary, input, output, limits, nullptr, server);
+        if (run.error || run.timed_out || run.exit_status != 0)
+            failed++;
+        outputs.push_back(readAll(output));
+    }
+    auto end = chrono::steady_clock::now();
+    return chrono::duration<double, milli>(end - start).count();
+}
+
+int main(int argc, char *argv[]) {
+    int tests = argc > 1 ? stoi(argv[1]) : 300;
+    fs::create_directories(WORK_DIR);
+
+    string source = WORK_DIR + "/solution.cpp";
+    ofstream(source) << SOLUTION;
+    mt19937 rng(2024);
+    vector<string> inputs;
+    for (int k = 0; k < tests; k++) {
+        string input = WORK_DIR + "/test" + to_string(k) + ".in";
+        ofstream(input) << rng() % 1000000 << ' ' << rng() % 1000000 << '\n';
+        inputs.push_back(input);
+    }
+
+    string plain = WORK_DIR + "/plain";
+    string shimmed = WORK_DIR + "/shimmed";
+    string link_args = forkServerLinkArgs(FLAGS);
+    if (link_args.empty()) {
+        cerr << "Could not build the fork-server shim\n";
+        return 1;
+    }
+    if (!compileSource(source, plain, FLAGS) ||
+        !compileSource(source, shimmed, FLAGS, link_args)) {
+        cerr << "Could not compile the solution\n";
+        return 1;
+    }
+
+    vector<string> exec_outputs, fork_outputs, shim_outputs;
+    int exec_failed, fork_failed, shim_failed;
+    double exec_ms = runAll(plain, inputs, nullptr, exec_outputs, exec_failed);
+    // The shim is invisible without the fork server
+    double shim_ms =
+        runAll(shimmed, inputs, nullptr, shim_outputs, shim_failed);
+
+    auto start = chrono::steady_clock::now();
+    RunLimits limits;
+    limits.memory_limit_bytes = 256L << 20;
+    ForkServer server(shimmed, limits);
+    double startup_ms = chrono::duration<double, milli>(
+                            chrono::steady_clock::now() - start)
+                            .count();
+    if (!server.ok()) {
+        cerr << "Fork server did not start\n";
+        return 1;
+    }
+    double fork_ms =
+        runAll(shimmed, inputs, &server, fork_outputs, fork_failed);
+
+    cout << tests << " tests of a+b\n"
+         << left << setw(28) << "mode" << right << setw(12) << "total ms"
+         << setw(14) << "ms per test" << setw(10) << "failed" << '\n';
+    auto row = [&](const string &mode, double ms, int failed) {
+        cout << left << setw(28) << mode << right << fixed << setprecision(1)
+             << setw(12) << ms << setprecision(3) << setw(14) << ms / tests
+             << setw(10) << failed << '\n';
+    };
+    row("exec per test", exec_ms, exec_failed);
+    row("exec per test (shim)", shim_ms, shim_failed);
+    row("fork server", startup_ms + fork_ms, fork_failed);
+    cout << "fork server startup: " << setprecision(1) << startup_ms
+         << " ms, speedup " << setprecision(2)
+         << exec_ms / (startup_ms + fork_ms) << "x\n";
+
+    bool same = exec_outputs == fork_outputs && exec_outputs == shim_outputs;
+    cout << (same ? "outputs identical" : "OUTPUTS DIFFER") << '\n';
+
+    error_code ec;
+    fs::remove_all(WORK_DIR, ec);
+    return same ? 0 : 1;
+}
@@ -0,0 +1,143 @@
+// Synthetic request files for the OJ, in the Test/*.txt format.
+//
+// Usage (from the repository root):
+//   ./bench/loadgen [options] > Test/<name>.txt
+//     --count <n>            submissions (default 100)
+//     --threads <n>          judge workers written in the header (default 4)
+//     --arrival constant|poisson|bursty   arrival process (default poisson)
+//     --rate <r>             mean submissions per second (default 20)
+//     --burst <n>            submissions per burst for bursty (default 8)
+//     --mix probA:3,probB:1  problem weights (default: every problem, equal)
+//     --verdicts ac:0.6,wa:0.3,tle:0.1    share of AC/WA/TLE solutions
+//     --seed <n>             random seed (default 1)
+//
+// Submissions are Submit/<problem>_AC|WA|TLE.cpp, so a problem needs all
+// three to be picked.
+
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace std;
+namespace fs = std::filesystem;
+
+// "a:1,b:2" -> {{a, 1}, {b, 2}}
+static vector<pair<string, double>> parseWeights(const string &spec) {
+    vector<pair<string, double>> weights;
+    stringstream in(spec);
+    string item;
+    while (getline(in, item, ',')) {
+        size_t colon = item.find(':');
+        if (colon == string::npos)
+            weights.push_back({item, 1});
+        else
+            weights.push_back({item.substr(0, colon),
+                               stod(item.substr(colon + 1))});
+    }
+    return weights;
+}
+
+// Problems with an AC, a WA and a TLE solution in Submit/
+static vector<pair<string, double>> defaultMix() {
+    vector<pair<string, double>> mix;
+    for (const auto &entry : fs::directory_iterator("problem")) {
+        string name = entry.path().filename().string();
+        bool complete = true;
+        for (const char *kind : {"_AC", "_WA", "_TLE"})
+            complete =
+                complete && fs::exists("Submit/" + name + kind + ".cpp");
+        if (entry.is_directory() && complete)
+            mix.push_back({name, 1});
+    }
+    sort(mix.begin(), mix.end());
+    return mix;
+}
+
+static size_t pick(const vector<pair<string, double>> &weights,
+                   mt19937_64 &rng) {
+    vector<double> w;
+    for (const auto &item : weights)
+        w.push_back(item.second);
+    discrete_distribution<size_t> dist(w.begin(), w.end());
+    return dist(rng);
+}
+
+int main(int argc, char *argv[]) {
+    int count = 100, threads = 4, burst = 8;
+    double rate = 20;
+    string arrival = "poisson", mix_spec;
+    string verdict_spec = "ac:0.6,wa:0.3,tle:0.1";
+    unsigned long seed = 1;
+
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (i + 1 >= argc) {
+            cerr << "Missing value for " << arg << '\n';
+            return 1;
+        }
+        string value = argv[++i];
+        if (arg == "--count")
+            count = stoi(value);
+        else if (arg == "--threads")
+            threads = stoi(value);
+        else if (arg == "--arrival")
+            arrival = value;
+        else if (arg == "--rate")
+            rate = stod(value);
+        else if (arg == "--burst")
+            burst = max(1, stoi(value));
+        else if (arg == "--mix")
+            mix_spec = value;
+        else if (arg == "--verdicts")
+            verdict_spec = value;
+        else if (arg == "--seed")
+            seed = stoul(value);
+        else {
+            cerr << "Unknown option " << arg << '\n';
+            return 1;
+        }
+    }
+    if (arrival != "constant" && arrival != "poisson" && arrival != "bursty") {
+        cerr << "Unknown arrival process " << arrival << '\n';
+        return 1;
+    }
+
+    vector<pair<string, double>> mix =
+        mix_spec.empty() ? defaultMix() : parseWeights(mix_spec);
+    vector<pair<string, double>> verdicts = parseWeights(verdict_spec);
+    if (mix.empty() || verdicts.empty()) {
+        cerr << "No problems or verdicts to pick from\n";
+        return 1;
+    }
+
+    mt19937_64 rng(seed);
+    exponential_distribution<double> gap(rate / 1000.0); // per ms
+    double mean_gap_ms = 1000.0 / rate;
+
+    cout << count << ' ' << threads << '\n';
+    double time_ms = 0;
+    for (int i = 0; i < count; i++) {
+        if (i > 0) {
+            if (arrival == "constant")
+                time_ms += mean_gap_ms;
+            else if (arrival == "poisson")
+                time_ms += gap(rng);
+            else if (i % burst == 0) // bursty: same mean rate, in clumps
+                time_ms += mean_gap_ms * burst;
+        }
+
+        string problem = mix[pick(mix, rng)].first;
+        string kind = verdicts[pick(verdicts, rng)].first;
+        for (char &c : kind)
+            c = toupper(c);
+        cout << (long)time_ms << ' ' << problem << ' ' << problem << '_'
+             << kind << '\n';
+    }
+    return 0;
+}
@@ -0,0 +1,154 @@
+// Checks of the thread pool's pick order: schedulingScore under each policy,
+// SJF and FAIR picks of a real pool, and that idle workers steal queued
+// tasks from a busy one. Exits non-zero on the first failed check.
+//
+// Usage (from the repository root): ./bench/scheduler_test
+
+#include "cost_model.h"
+#include "thread_pool.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <future>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+static int failures = 0;
+
+static void check(bool ok, const string &what) {
+    cout << (ok ? "ok    " : "FAIL  ") << what << '\n';
+    if (!ok)
+        failures++;
+}
+
+static void scoreChecks() {
+    map<string, double> served = {{"busy", 500}, {"idle", 10}};
+
+    // SJF: shorter expected first, then older
+    check(schedulingScore(SchedulePolicy::SJF, 5, 9, "", served) <
+              schedulingScore(SchedulePolicy::SJF, 50, 1, "", served),
+          "SJF picks the shorter job over the older one");
+    check(schedulingScore(SchedulePolicy::SJF, 5, 1, "", served) <
+              schedulingScore(SchedulePolicy::SJF, 5, 2, "", served),
+          "SJF breaks ties by submission order");
+
+    // FAIR: the group served least first, an unseen group before both
+    check(schedulingScore(SchedulePolicy::FAIR, 0, 9, "idle", served) <
+              schedulingScore(SchedulePolicy::FAIR, 0, 1, "busy", served),
+          "FAIR picks the group served least");
+    check(schedulingScore(SchedulePolicy::FAIR, 0, 9, "new", served) <
+              schedulingScore(SchedulePolicy::FAIR, 0, 1, "idle", served),
+          "FAIR picks a group never served first");
+    check(schedulingScore(SchedulePolicy::FAIR, 1, 1, "busy", served) <
+              schedulingScore(SchedulePolicy::FAIR, 0, 2, "busy", served),
+          "FAIR ignores the expected duration within a group");
+
+    // FIFO: submission order only
+    check(schedulingScore(SchedulePolicy::FIFO, 50, 1, "busy", served) <
+              schedulingScore(SchedulePolicy::FIFO, 5, 2, "idle", served),
+          "FIFO picks the oldest task");
+}
+
+// Run `tasks` (name, info) on a single worker held busy until all are
+// queued, so the order they run in is the policy's pick order
+static vector<string> pickOrder(SchedulePolicy policy, CostModel &costs,
+                                const TaskInfo &blocker_info,
+                                const vector<pair<string, TaskInfo>> &tasks) {
+    vector<string> order;
+    mutex order_mutex;
+    promise<void> queued;
+    shared_future<void> all_queued = queued.get_future().share();
+
+    ThreadPool pool(1, {}, policy, &costs);
+    pool.add_task(
+        [all_queued] {
+            all_queued.wait();
+            this_thread::sleep_for(chrono::milliseconds(20));
+        },
+        blocker_info);
+    for (const auto &task : tasks) {
+        string name = task.first;
+        pool.add_task(
+            [&order, &order_mutex, name] {
+                lock_guard<mutex> lock(order_mutex);
+                order.push_back(name);
+            },
+            task.second);
+    }
+    queued.set_value();
+    pool.wait_idle();
+    return order;
+}
+
+static void pickChecks() {
+    CostModel costs;
+    costs.record("short", 1);
+    costs.record("medium", 10);
+    costs.record("long", 100);
+    vector<string> sjf = pickOrder(SchedulePolicy::SJF, costs, {},
+                                   {{"long", {"", "long"}},
+                                    {"short", {"", "short"}},
+                                    {"medium", {"", "medium"}}});
+    check(sjf == vector<string>({"short", "medium", "long"}),
+          "SJF pool runs queued jobs shortest first");
+
+    // The blocker charges its time to group a, so b goes first
+    CostModel none;
+    vector<string> fair = pickOrder(
+        SchedulePolicy::FAIR, none, {"a", "a"},
+        {{"a1", {"a", "a"}}, {"a2", {"a", "a"}}, {"b1", {"b", "b"}},
+         {"b2", {"b", "b"}}});
+    check(fair == vector<string>({"b1", "b2", "a1", "a2"}),
+          "FAIR pool runs the group served least first");
+
+    vector<string> fifo = pickOrder(SchedulePolicy::FIFO, costs, {},
+                                    {{"long", {"", "long"}},
+                                     {"short", {"", "short"}}});
+    check(fifo == vector<string>({"long", "short"}),
+          "FIFO pool runs jobs in submission order");
+}
+
+static void stealChecks() {
+    const int TASKS = 8;
+    ThreadPool pool(4);
+    mutex seen_mutex;
+    condition_variable all_done;
+    set<thread::id> ran_on;
+    int done = 0;
+    bool finished = false;
+
+    // Everything a task submits stays on its worker's deque; that worker
+    // then waits for them, so they only run if other workers steal them
+    pool.add_task([&] {
+        thread::id self = this_thread::get_id();
+        for (int k = 0; k < TASKS; k++)
+            pool.add_task([&] {
+                lock_guard<mutex> lock(seen_mutex);
+                ran_on.insert(this_thread::get_id());
+                if (++done == TASKS)
+                    all_done.notify_all();
+            });
+        unique_lock<mutex> lock(seen_mutex);
+        finished = all_done.wait_for(lock, chrono::seconds(5),
+                                     [&] { return done == TASKS; });
+        ran_on.erase(self);
+    });
+    pool.wait_idle();
+    check(finished && !ran_on.empty(),
+          "idle workers steal tasks queued on a busy worker");
+}
+
+int main() {
+    scoreChecks();
+    pickChecks();
+    stealChecks();
+    cout << (failures ? "FAILED" : "all passed") << '\n';
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,44 @@
+// Example special-judge checker (see oj_checker.h): the output must have as
+// many numbers as the answer, each within 1e-6 absolute or relative error
+#include "oj_checker.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <string>
+
+static const double TOLERANCE = 1e-6;
+
+// Next whitespace-separated token of [data, data + size) from `pos`
+static bool nextToken(const char *data, size_t size, size_t &pos,
+                      std::string &token) {
+    while (pos < size && (unsigned char)data[pos] <= ' ')
+        pos++;
+    if (pos == size)
+        return false;
+    size_t start = pos;
+    while (pos < size && (unsigned char)data[pos] > ' ')
+        pos++;
+    token.assign(data + start, pos - start);
+    return true;
+}
+
+extern "C" int oj_check(const char *, size_t, const char *output,
+                        size_t output_size, const char *answer,
+                        size_t answer_size) {
+    size_t out_pos = 0, ans_pos = 0;
+    std::string got, want;
+    while (true) {
+        bool has_got = nextToken(output, output_size, out_pos, got);
+        bool has_want = nextToken(answer, answer_size, ans_pos, want);
+        if (!has_got || !has_want)
+            return has_got == has_want ? OJ_ACCEPTED : OJ_WRONG_ANSWER;
+        char *end;
+        double x = std::strtod(got.c_str(), &end);
+        if (*end != '\0')
+            return OJ_WRONG_ANSWER;
+        double y = std::strtod(want.c_str(), nullptr);
+        double error = std::fabs(x - y);
+        if (!(error <= TOLERANCE || error <= TOLERANCE * std::fabs(y)))
+            return OJ_WRONG_ANSWER;
+    }
+}
@@ -0,0 +1,283 @@
+#include "checker.h"
+
+#include <cstring> // for memchr
+
+#include <fcntl.h>    // for open
+#include <sys/mman.h> // for mmap
+#include <sys/stat.h> // for fstat
+#include <unistd.h>   // for close
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+
+static inline bool isBlank(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+#ifdef __SSE2__
+// Bit i is set when byte i of the chunk is a blank
+static inline unsigned blankMask(__m128i chunk) {
+    __m128i blank = _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8(' ')),
+                     _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\t'))),
+        _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('\r')),
+                                  _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\v'))),
+                     _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\f'))));
+    return (unsigned)_mm_movemask_epi8(blank);
+}
+#endif
+
+// Index of the first non-blank byte at or after i
+static size_t skipBlanks(const char *data, size_t i, size_t size) {
+#ifdef __SSE2__
+    while (i + 16 <= size) {
+        __m128i chunk = _mm_loadu_si128((const __m128i *)(data + i));
+        unsigned mask = blankMask(chunk);
+        if (mask != 0xFFFF)
+            return i + __builtin_ctz(~mask);
+        i += 16;
+    }
+#endif
+    while (i < size && isBlank(data[i]))
+        i++;
+    return i;
+}
+
+// Length of the longest common prefix of a and b. `newlines` counts the
+// '\n' bytes in it and `line_end` is the offset just past the last of them
+// (0 if there is none).
+static size_t commonPrefix(const char *a, size_t a_size, const char *b,
+                           size_t b_size, size_t &newlines, size_t &line_end) {
+    size_t n = 0;
+    newlines = line_end = 0;
+#ifdef __SSE2__
+    while (n + 16 <= a_size && n + 16 <= b_size) {
+        __m128i chunk_a = _mm_loadu_si128((const __m128i *)(a + n));
+        __m128i chunk_b = _mm_loadu_si128((const __m128i *)(b + n));
+        unsigned same =
+            (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(chunk_a, chunk_b));
+        unsigned newline = (unsigned)_mm_movemask_epi8(
+            _mm_cmpeq_epi8(chunk_a, _mm_set1_epi8('\n')));
+        size_t length = 16;
+        if (same != 0xFFFF) {
+            length = __builtin_ctz(~same);
+            newline &= (1u << length) - 1;
+        }
+        if (newline) {
+            newlines += __builtin_popcount(newline);
+            line_end = n + (31 - __builtin_clz(newline)) + 1;
+        }
+        n += length;
+        if (length < 16)
+            return n;
+    }
+#endif
+    while (n < a_size && n < b_size && a[n] == b[n]) {
+        if (a[n] == '\n') {
+            newlines++;
+            line_end = n + 1;
+        }
+        n++;
+    }
+    return n;
+}
+
+// Length of the common prefix of a and b that stays within the current line
+static size_t sameInLine(const char *a, size_t a_size, const char *b,
+                         size_t b_size) {
+    size_t n = 0;
+#ifdef __SSE2__
+    while (n + 16 <= a_size && n + 16 <= b_size) {
+        __m128i chunk_a = _mm_loadu_si128((const __m128i *)(a + n));
+        __m128i chunk_b = _mm_loadu_si128((const __m128i *)(b + n));
+        unsigned same =
+            (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(chunk_a, chunk_b));
+        unsigned newline = (unsigned)_mm_movemask_epi8(
+            _mm_cmpeq_epi8(chunk_a, _mm_set1_epi8('\n')));
+        unsigned plain = same & ~newline & 0xFFFF;
+        if (plain != 0xFFFF)
+            return n + __builtin_ctz(~plain);
+        n += 16;
+    }
+#endif
+    while (n < a_size && n < b_size && a[n] == b[n] && a[n] != '\n')
+        n++;
+    return n;
+}
+
+CompareResult compareBuffers(const char *output, size_t output_size,
+                             const char *expected, size_t expected_size) {
+    CompareResult result;
+    size_t i = 0, j = 0;
+
+    while (true) {
+        // Skip whole lines that are byte-identical in both files
+        size_t newlines, line_end;
+        size_t same = commonPrefix(output + i, output_size - i, expected + j,
+                                   expected_size - j, newlines, line_end);
+        if (i + same == output_size && j + same == expected_size) {
+            result.equal = true;
+            return result;
+        }
+        i += line_end;
+        j += line_end;
+        result.line += newlines;
+
+        // Both files ran out of lines at the same time
+        if (i == output_size && j == expected_size) {
+            result.equal = true;
+            return result;
+        }
+        // One file has more lines than the other
+        if (i == output_size || j == expected_size) {
+            result.offset = i;
+            return result;
+        }
+
+        // Compare one line, ignoring blanks; end of file also ends a line
+        while (true) {
+            size_t run = sameInLine(output + i, output_size - i,
+                                    expected + j, expected_size - j);
+            i += run;
+            j += run;
+            i = skipBlanks(output, i, output_size);
+            j = skipBlanks(expected, j, expected_size);
+
+            char a = i < output_size ? output[i] : '\n';
+            char b = j < expected_size ? expected[j] : '\n';
+            if (a != b) {
+                result.offset = i;
+                return result;
+            }
+            if (a == '\n') {
+                if (i < output_size) {
+                    i++;
+                    result.line++;
+                }
+                if (j < expected_size)
+                    j++;
+                break;
+            }
+            i++;
+            j++;
+        }
+    }
+}
+
+MappedFile::MappedFile(const string &path) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return;
+    struct stat st;
+    if (fstat(fd, &st) == 0) {
+        size = (size_t)st.st_size;
+        if (size == 0) {
+            ok = true;
+        } else {
+            void *addr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (addr != MAP_FAILED) {
+                // The comparison walks both files front to back
+                madvise(addr, size, MADV_SEQUENTIAL);
+                data = (const char *)addr;
+                ok = true;
+            }
+        }
+    }
+    close(fd);
+}
+
+MappedFile::~MappedFile() {
+    if (data)
+        munmap((void *)data, size);
+}
+
+CompareResult compareFiles(const string &output_file,
+                           const string &expected_file) {
+    MappedFile output(output_file), expected(expected_file);
+    if (!output.ok || !expected.ok) {
+        CompareResult result;
+        result.error = true;
+        return result;
+    }
+    return compareBuffers(output.data, output.size, expected.data,
+                          expected.size);
+}
+
+StreamComparer::StreamComparer(const string &expected_file)
+    : expected(expected_file) {
+    result.error = !expected.ok;
+}
+
+// Make the next expected line current; false if the expected output has no
+// lines left
+bool StreamComparer::openLine() {
+    if (line_start >= expected.size)
+        return false;
+    const char *end = (const char *)memchr(expected.data + line_start, '\n',
+                                           expected.size - line_start);
+    line_end = end ? (size_t)(end - expected.data) : expected.size;
+    cursor = line_start;
+    line_open = true;
+    return true;
+}
+
+// The output line ended: the rest of the expected line must be blanks
+bool StreamComparer::closeLine() {
+    cursor = skipBlanks(expected.data, cursor, line_end);
+    if (cursor != line_end)
+        return false;
+    line_start = line_end + 1;
+    line_open = false;
+    return true;
+}
+
+bool StreamComparer::feed(const char *data, size_t size) {
+    if (failed || result.error)
+        return false;
+
+    for (size_t k = 0; k < size; k++, offset++) {
+        char c = data[k];
+        if (!line_open && !openLine()) {
+            // More output lines than expected
+            return fail();
+        }
+        if (c == '\n') {
+            if (!closeLine())
+                return fail();
+            result.line++;
+        } else if (!isBlank(c)) {
+            cursor = skipBlanks(expected.data, cursor, line_end);
+            if (cursor == line_end || expected.data[cursor] != c)
+                return fail();
+            cursor++;
+        }
+    }
+    return true;
+}
+
+bool StreamComparer::fail() {
+    failed = true;
+    result.equal = false;
+    result.offset = offset;
+    return false;
+}
+
+CompareResult StreamComparer::finish() {
+    if (failed || result.error)
+        return result;
+    // An unterminated last output line ends at end of file
+    if (line_open && !closeLine()) {
+        fail();
+        return result;
+    }
+    // Fewer output lines than expected
+    if (line_start < expected.size) {
+        fail();
+        return result;
+    }
+    result.equal = true;
+    return result;
+}
@@ -0,0 +1,74 @@
+// checker.h
+#ifndef CHECKER_H
+#define CHECKER_H
+
+#include <cstddef>
+#include <string>
+
+/*
+ * Result of comparing a participant's output with the expected output:
+ *      equal  - the outputs match
+ *      offset - byte offset in the participant's output of the first
+ *               difference (meaningless when equal)
+ *      line   - 1-based line of that difference in the participant's output
+ *      error  - a file could not be opened or mapped (equal is false)
+ */
+struct CompareResult {
+    bool equal = false;
+    size_t offset = 0;
+    size_t line = 1;
+    bool error = false;
+};
+
+// Whitespace-insensitive comparison with the semantics of `diff -w`: both
+// inputs are split into lines, all blanks (space, \t, \r, \v, \f) inside a
+// line are ignored, and the number of lines must agree. A missing newline at
+// the end of the last line does not count as a difference.
+CompareResult compareBuffers(const char *output, size_t output_size,
+                             const char *expected, size_t expected_size);
+
+// compareBuffers over two files, mapped into memory instead of read
+CompareResult compareFiles(const std::string &output_file,
+                           const std::string &expected_file);
+
+// Read-only mapping of a whole file; empty files map to nothing
+struct MappedFile {
+    const char *data = nullptr;
+    size_t size = 0;
+    bool ok = false;
+
+    explicit MappedFile(const std::string &path);
+    ~MappedFile();
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+};
+
+/*
+ * compareBuffers for output that arrives in pieces, e.g. from a pipe.
+ * feed() returns false as soon as the output can no longer match, so the
+ * producer can be stopped early; finish() gives the verdict once the output
+ * is complete. Same semantics as compareBuffers.
+ */
+class StreamComparer {
+  private:
+    MappedFile expected;
+    CompareResult result;
+    bool failed = false;
+    size_t offset = 0; // bytes of output consumed
+
+    // Current expected line [line_start, line_end) and position in it
+    bool line_open = false;
+    size_t line_start = 0, line_end = 0, cursor = 0;
+
+    bool openLine();
+    bool closeLine();
+    bool fail();
+
+  public:
+    explicit StreamComparer(const std::string &expected_file);
+
+    bool feed(const char *data, size_t size);
+    CompareResult finish();
+};
+
+#endif // CHECKER_H
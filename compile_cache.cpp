@@ -0,0 +1,235 @@
+#include "compile_cache.h"
+#include "hashing.h"
+#include "metrics.h"
+
+#include <algorithm>  // for std::sort
+#include <cerrno>
+#include <csignal>    // for sigprocmask
+#include <cstdio>     // for popen
+#include <filesystem> // for cache directory management
+#include <fstream>    // for reading the source
+#include <iterator>   // for istreambuf_iterator
+#include <sstream>    // for the temp file name
+#include <thread>     // for this_thread::get_id
+#include <vector>
+
+#include <sys/wait.h> // for waitpid
+#include <unistd.h>   // for getpid, fork, execvp
+
+using namespace std;
+namespace fs = std::filesystem;
+
+const string CXX = "g++";
+const string CACHE_DIR = ".oj_cache/bin";
+const uintmax_t CACHE_MAX_BYTES = 256ull << 20; // 256 MB
+
+// Full `g++ --version` output, read once per process
+const string &compilerVersion() {
+    static const string version = [] {
+        string out;
+        FILE *pipe = popen((CXX + " --version 2>/dev/null").c_str(), "r");
+        if (pipe) {
+            char buf[256];
+            size_t n;
+            while ((n = fread(buf, 1, sizeof(buf), pipe)) > 0)
+                out.append(buf, n);
+            pclose(pipe);
+        }
+        return out;
+    }();
+    return version;
+}
+
+bool runCompiler(const string &flags, const vector<string> &args) {
+    vector<string> words = {CXX};
+    istringstream split(flags);
+    for (string word; split >> word;)
+        words.push_back(word);
+    words.insert(words.end(), args.begin(), args.end());
+    // Built before fork: the child may only exec
+    vector<char *> argv;
+    for (string &word : words)
+        argv.push_back(&word[0]);
+    argv.push_back(nullptr);
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        sigset_t none;
+        sigemptyset(&none);
+        sigprocmask(SIG_SETMASK, &none, nullptr);
+        execvp(argv[0], argv.data());
+        _exit(127);
+    }
+    if (pid < 0)
+        return false;
+    int status;
+    while (waitpid(pid, &status, 0) < 0)
+        if (errno != EINTR)
+            return false;
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+CompileCache::CompileCache(const string &dir, uintmax_t max_bytes)
+    : dir(dir), max_bytes(max_bytes) {
+    error_code ec;
+    fs::create_directories(dir, ec);
+
+    // Rebuild the LRU order from what previous runs left behind
+    vector<pair<fs::file_time_type, fs::path>> files;
+    for (const auto &entry : fs::directory_iterator(dir, ec)) {
+        if (!entry.is_regular_file())
+            continue;
+        // Half-written binaries from a crashed run
+        if (entry.path().extension() == ".tmp") {
+            fs::remove(entry.path(), ec);
+            continue;
+        }
+        files.emplace_back(entry.last_write_time(), entry.path());
+    }
+    sort(files.begin(), files.end());
+    for (const auto &file : files)
+        insert(file.second.filename().string());
+    evict();
+}
+
+string CompileCache::keyFor(const string &source, const string &flags) {
+    ifstream in(source, ios::binary);
+    string bytes((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+
+    // The binary under this name is handed out on a hit, so the name must
+    // be one no participant's source can collide with
+    return sha256Hex(bytes + '\0' + compilerVersion() + '\0' + flags);
+}
+
+// Caller holds cache_mutex, so the entry cannot be evicted under us
+bool CompileCache::linkCached(const string &key, const string &output) {
+    fs::path cached = fs::path(dir) / key;
+    error_code ec;
+    fs::remove(output, ec);
+    fs::create_hard_link(cached, output, ec);
+    if (ec) {
+        // e.g. cache on another filesystem
+        ec.clear();
+        fs::copy_file(cached, output, fs::copy_options::overwrite_existing,
+                      ec);
+        if (ec)
+            return false;
+    }
+
+    // Move to the front of the LRU list and persist the recency
+    auto it = index.find(key);
+    if (it != index.end())
+        lru.splice(lru.begin(), lru, it->second);
+    fs::last_write_time(cached, fs::file_time_type::clock::now(), ec);
+    return true;
+}
+
+// Caller holds cache_mutex (or is the constructor)
+void CompileCache::insert(const string &key) {
+    error_code ec;
+    uintmax_t size = fs::file_size(fs::path(dir) / key, ec);
+    if (ec)
+        return;
+    lru.push_front({key, size});
+    index[key] = lru.begin();
+    total_bytes += size;
+}
+
+// Caller holds cache_mutex. Drop `key` from the index, e.g. after another
+// process sharing the directory evicted its file.
+void CompileCache::forget(const string &key) {
+    auto it = index.find(key);
+    if (it == index.end())
+        return;
+    total_bytes -= it->second->size;
+    lru.erase(it->second);
+    index.erase(it);
+}
+
+// Caller holds cache_mutex. The newest entry is always kept, even when it
+// alone is over budget.
+void CompileCache::evict() {
+    while (total_bytes > max_bytes && lru.size() > 1) {
+        Entry victim = lru.back();
+        lru.pop_back();
+        index.erase(victim.key);
+        total_bytes -= victim.size;
+        // Executables already hard-linked from it stay valid
+        error_code ec;
+        fs::remove(fs::path(dir) / victim.key, ec);
+    }
+}
+
+bool CompileCache::compile(const string &source, const string &output,
+                           const string &flags, const string &extra_args) {
+    string key = keyFor(source, flags);
+
+    promise<bool> compiled;
+    {
+        unique_lock<mutex> lock(cache_mutex);
+
+        // Cache hit, unless the file is gone: other processes share the
+        // directory and evict from it too. Then compile it again.
+        if (index.count(key)) {
+            if (linkCached(key, output)) {
+                countEvent(Counter::CACHE_HITS);
+                return true;
+            }
+            forget(key);
+        }
+
+        // Someone else is compiling the same thing, wait for their result
+        auto pending = in_flight.find(key);
+        if (pending != in_flight.end()) {
+            shared_future<bool> result = pending->second;
+            lock.unlock();
+            countEvent(Counter::CACHE_HITS);
+            if (!result.get())
+                return false;
+            lock.lock();
+            if (index.count(key) && linkCached(key, output))
+                return true;
+            // Evicted in between (tiny cache, or by another process):
+            // compile it ourselves
+            forget(key);
+            lock.unlock();
+            return compile(source, output, flags, extra_args);
+        }
+
+        in_flight[key] = compiled.get_future().share();
+    }
+    countEvent(Counter::CACHE_MISSES);
+
+    // We own this key: compile into a temp name, then publish atomically.
+    // Worker processes share the cache, hence the pid in the name.
+    ostringstream tmp_name;
+    tmp_name << key << '.' << getpid() << '.' << this_thread::get_id()
+             << ".tmp";
+    fs::path tmp = fs::path(dir) / tmp_name.str();
+    bool ok = runCompiler(flags + " " + extra_args,
+                          {source, "-o", tmp.string()});
+
+    error_code ec;
+    if (ok) {
+        fs::rename(tmp, fs::path(dir) / key, ec);
+        ok = !ec;
+    }
+    if (!ok)
+        fs::remove(tmp, ec);
+
+    unique_lock<mutex> lock(cache_mutex);
+    bool linked = false;
+    if (ok) {
+        insert(key);
+        linked = linkCached(key, output);
+        evict();
+    }
+    in_flight.erase(key);
+    compiled.set_value(ok);
+    return linked;
+}
+
+CompileCache &compileCache() {
+    static CompileCache cache(CACHE_DIR, CACHE_MAX_BYTES);
+    return cache;
+}
@@ -0,0 +1,75 @@
+// compile_cache.h
+#ifndef COMPILE_CACHE_H
+#define COMPILE_CACHE_H
+
+#include <cstdint>
+#include <future>
+#include <list>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/*
+ * Content-addressed cache of compiled participant binaries.
+ *
+ * A binary is stored under a hash of (source bytes, compiler version, compile
+ * flags). A repeat submission hard-links the cached binary to its executable
+ * name instead of running the compiler again. When several workers ask for
+ * the same key at once, the first one compiles and the rest wait on its
+ * result. The cache directory is bounded in bytes and evicts the least
+ * recently used binaries; recency survives restarts through file mtimes.
+ */
+class CompileCache {
+  private:
+    struct Entry {
+        std::string key;
+        uintmax_t size;
+    };
+
+    std::string dir;
+    uintmax_t max_bytes;
+    uintmax_t total_bytes = 0;
+
+    // Most recently used at the front
+    std::list<Entry> lru;
+    std::map<std::string, std::list<Entry>::iterator> index;
+
+    // Keys currently being compiled by some worker
+    std::map<std::string, std::shared_future<bool>> in_flight;
+
+    std::mutex cache_mutex;
+
+    std::string keyFor(const std::string &source, const std::string &flags);
+    bool linkCached(const std::string &key, const std::string &output);
+    void insert(const std::string &key);
+    void forget(const std::string &key);
+    void evict();
+
+  public:
+    CompileCache(const std::string &dir, uintmax_t max_bytes);
+
+    // Build `source` into the executable `output`, reusing a cached binary
+    // when possible. `extra_args` are passed to the compiler but are not part
+    // of the key, so they must not change the produced binary (e.g. the
+    // precompiled header include path). Returns false on a compile error.
+    bool compile(const std::string &source, const std::string &output,
+                 const std::string &flags, const std::string &extra_args = "");
+};
+
+// Compiler driver used for participant code
+extern const std::string CXX;
+
+// Full `g++ --version` output, read once per process
+const std::string &compilerVersion();
+
+// Run CXX without a shell and wait for it; true when it exits with 0.
+// `flags` is one of our own option strings and is split on whitespace,
+// each of `args` (typically paths) is passed as exactly one argument.
+bool runCompiler(const std::string &flags,
+                 const std::vector<std::string> &args);
+
+// The cache shared by all judge workers
+CompileCache &compileCache();
+
+#endif // COMPILE_CACHE_H
@@ -0,0 +1,228 @@
+#include "compile_server.h"
+#include "compile_cache.h"
+#include "hashing.h"
+#include "thread_pool.h"
+
+#include <cstdio>     // for popen
+#include <filesystem> // for the PCH directory
+#include <fstream>    // for the warm-up source
+#include <map>        // for the per-flag-set PCH table
+#include <memory>     // for unique_ptr
+#include <vector>
+
+#include <unistd.h> // for getpid in temp names
+
+using namespace std;
+namespace fs = std::filesystem;
+
+const string PCH_DIR = ".oj_cache/pch";
+const string PCH_HEADER = "bits/stdc++.h";
+const string FORK_SERVER_DIR = ".oj_cache/forkserver";
+const string FORK_SERVER_SHIM = "forkserver_shim.cpp";
+const string FORK_SERVER_HEADER = "forkserver.h";
+
+// Ask the compiler which file <bits/stdc++.h> resolves to for these flags
+static string locateHeader(const string &flags) {
+    string command = "echo '#include <" + PCH_HEADER + ">' | " + CXX + " " +
+                     flags + " -H -fsyntax-only -x c++ - 2>&1";
+    string path;
+    FILE *pipe = popen(command.c_str(), "r");
+    if (!pipe)
+        return path;
+    // -H prints one ". <path>" line per top-level include, ours comes first
+    char line[4096];
+    if (fgets(line, sizeof(line), pipe) && line[0] == '.' && line[1] == ' ') {
+        path = line + 2;
+        while (!path.empty() && (path.back() == '\n' || path.back() == '\r'))
+            path.pop_back();
+    }
+    pclose(pipe);
+    return path;
+}
+
+static string buildPrecompiledHeader(const string &flags) {
+    // One directory per (compiler, flags): a PCH is only valid for the exact
+    // flags it was built with
+    string key = toHex(fnv1a(compilerVersion() + '\0' + flags));
+    fs::path include_dir = fs::path(PCH_DIR) / key;
+    fs::path header = include_dir / PCH_HEADER;
+    fs::path gch = header.string() + ".gch";
+
+    error_code ec;
+    if (fs::exists(gch, ec))
+        return include_dir.string();
+
+    string original = locateHeader(flags);
+    if (original.empty())
+        return "";
+
+    // Keep a copy of the header next to the .gch, so a source that cannot use
+    // the PCH still finds the header in the same directory
+    fs::create_directories(header.parent_path(), ec);
+    fs::copy_file(original, header, fs::copy_options::overwrite_existing, ec);
+    if (ec)
+        return "";
+
+    fs::path tmp = gch.string() + ".tmp";
+    vector<string> args = {"-x", "c++-header", header.string(), "-o",
+                           tmp.string()};
+    if (!runCompiler(flags, args)) {
+        fs::remove(tmp, ec);
+        return "";
+    }
+    fs::rename(tmp, gch, ec);
+    return ec ? "" : include_dir.string();
+}
+
+string precompiledHeaderArgs(const string &flags) {
+    static mutex pch_mutex;
+    static map<string, string> built; // flags -> compiler args
+
+    // Held for the whole build, so concurrent callers wait for the one
+    // building instead of racing on the same files
+    lock_guard<mutex> lock(pch_mutex);
+    auto it = built.find(flags);
+    if (it != built.end())
+        return it->second;
+
+    string include_dir = buildPrecompiledHeader(flags);
+    string args = include_dir.empty() ? "" : "-I" + include_dir;
+    built[flags] = args;
+    return args;
+}
+
+static string readFile(const string &path) {
+    ifstream in(path, ios::binary);
+    return string((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+}
+
+static string buildForkServerShim(const string &flags) {
+    string shim = readFile(FORK_SERVER_SHIM);
+    if (shim.empty())
+        return "";
+    // Same rule as the PCH: one object per (compiler, flags, shim source)
+    string key = toHex(fnv1a(compilerVersion() + '\0' + flags + '\0' + shim +
+                             '\0' + readFile(FORK_SERVER_HEADER)));
+    fs::path object = fs::path(FORK_SERVER_DIR) / (key + ".o");
+
+    error_code ec;
+    if (fs::exists(object, ec))
+        return object.string();
+    fs::create_directories(FORK_SERVER_DIR, ec);
+    fs::path tmp = object.string() + "." + to_string(getpid()) + ".tmp";
+    if (!runCompiler(flags, {"-c", FORK_SERVER_SHIM, "-o", tmp.string()})) {
+        fs::remove(tmp, ec);
+        return "";
+    }
+    fs::rename(tmp, object, ec);
+    return ec ? "" : object.string();
+}
+
+string forkServerLinkArgs(const string &flags) {
+    static mutex shim_mutex;
+    static map<string, string> built; // flags -> linker args
+
+    lock_guard<mutex> lock(shim_mutex);
+    auto it = built.find(flags);
+    if (it != built.end())
+        return it->second;
+
+    string object = buildForkServerShim(flags);
+    string args = object.empty() ? "" : object + " -Wl,--wrap=main";
+    built[flags] = args;
+    return args;
+}
+
+// Flags as the compile cache sees them: linking in the shim makes a
+// different binary
+static string linkedFlags(const string &flags, const string &link_args) {
+    return link_args.empty() ? flags : flags + " " + link_args;
+}
+
+CompileServer::CompileServer(int num_workers, const string &flags,
+                             const vector<int> &cpus) {
+    warmUp(flags);
+
+    for (int i = 0; i < num_workers; i++) {
+        workers.emplace_back([this, cpus] {
+            restrictToCpus(cpus);
+            while (true) {
+                Job job;
+                {
+                    unique_lock<mutex> lock(jobs_mutex);
+                    condition.wait(lock,
+                                   [this] { return stop || !jobs.empty(); });
+                    if (stop && jobs.empty())
+                        return;
+                    job = move(jobs.front());
+                    jobs.pop();
+                }
+                job.done.set_value(compileCache().compile(
+                    job.source, job.output, linkedFlags(job.flags,
+                                                        job.link_args),
+                    precompiledHeaderArgs(job.flags)));
+            }
+        });
+    }
+}
+
+// Build the PCH and run one throwaway compile through it, which pulls the
+// .gch, cc1plus, as and ld into the page cache before the first submission
+void CompileServer::warmUp(const string &flags) {
+    string args = precompiledHeaderArgs(flags);
+
+    error_code ec;
+    fs::create_directories(PCH_DIR, ec);
+    fs::path source = fs::path(PCH_DIR) / "warmup.cpp";
+    fs::path binary = fs::path(PCH_DIR) / "warmup";
+    {
+        ofstream out(source);
+        out << "#include <" << PCH_HEADER << ">\nint main() { return 0; }\n";
+    }
+    runCompiler(flags + " " + args, {source.string(), "-o", binary.string()});
+    fs::remove(source, ec);
+    fs::remove(binary, ec);
+}
+
+CompileServer::~CompileServer() {
+    {
+        unique_lock<mutex> lock(jobs_mutex);
+        stop = true;
+    }
+    condition.notify_all();
+    for (thread &t : workers)
+        t.join();
+}
+
+future<bool> CompileServer::submit(const string &source, const string &output,
+                                   const string &flags,
+                                   const string &link_args) {
+    Job job;
+    job.source = source;
+    job.output = output;
+    job.flags = flags;
+    job.link_args = link_args;
+    future<bool> result = job.done.get_future();
+    {
+        unique_lock<mutex> lock(jobs_mutex);
+        jobs.push(move(job));
+    }
+    condition.notify_one();
+    return result;
+}
+
+static unique_ptr<CompileServer> server;
+
+void startCompileServer(int num_workers, const string &flags,
+                        const vector<int> &cpus) {
+    server.reset(new CompileServer(num_workers, flags, cpus));
+}
+
+bool compileSource(const string &source, const string &output,
+                   const string &flags, const string &link_args) {
+    if (server)
+        return server->submit(source, output, flags, link_args).get();
+    return compileCache().compile(source, output,
+                                  linkedFlags(flags, link_args),
+                                  precompiledHeaderArgs(flags));
+}
@@ -0,0 +1,75 @@
+// compile_server.h
+#ifndef COMPILE_SERVER_H
+#define COMPILE_SERVER_H
+
+#include <condition_variable>
+#include <future>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Build (once per flag set, reused across runs) a precompiled
+// <bits/stdc++.h> and return the compiler arguments that make participant
+// compiles pick it up. Returns "" if the header could not be precompiled, in
+// which case compiles simply parse the header as before.
+std::string precompiledHeaderArgs(const std::string &flags);
+
+// Build (once per flag set) the fork-server shim (forkserver_shim.cpp) and
+// return the linker arguments that wrap a participant's main() with it.
+// Returns "" if the shim could not be built.
+std::string forkServerLinkArgs(const std::string &flags);
+
+/*
+ * Long-lived compile workers.
+ *
+ * Judge workers hand their compiles to a fixed set of compile threads instead
+ * of running g++ themselves. The workers warm the precompiled header and the
+ * compiler binaries into the page cache at startup and then stay up between
+ * submissions, so no submission pays that first-compile cost and the number
+ * of concurrent g++ processes is bounded by the server, not by the pool.
+ */
+class CompileServer {
+  private:
+    struct Job {
+        std::string source;
+        std::string output;
+        std::string flags;
+        std::string link_args;
+        std::promise<bool> done;
+    };
+
+    std::vector<std::thread> workers;
+    std::queue<Job> jobs;
+    std::mutex jobs_mutex;
+    std::condition_variable condition;
+    bool stop = false;
+
+    void warmUp(const std::string &flags);
+
+  public:
+    // Workers (and the g++ processes they start) run on `cpus`, if given
+    CompileServer(int num_workers, const std::string &flags,
+                  const std::vector<int> &cpus = {});
+    ~CompileServer();
+
+    // Queue a compile; the future yields false on a compile error
+    std::future<bool> submit(const std::string &source,
+                             const std::string &output,
+                             const std::string &flags,
+                             const std::string &link_args = "");
+};
+
+// Start the shared compile server; until this is called compileSource()
+// compiles on the calling thread
+void startCompileServer(int num_workers, const std::string &flags,
+                        const std::vector<int> &cpus = {});
+
+// Compile through the server if it is running, otherwise inline. Both paths
+// use the compile cache and the precompiled header. `link_args` (e.g. from
+// forkServerLinkArgs) are part of the cache key, unlike the PCH.
+bool compileSource(const std::string &source, const std::string &output,
+                   const std::string &flags, const std::string &link_args = "");
+
+#endif // COMPILE_SERVER_H
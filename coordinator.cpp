@@ -0,0 +1,365 @@
+#include "coordinator.h"
+#include "result_log.h"
+#include "wire.h"
+#include "worker.h"
+
+#include <cerrno>
+#include <csignal> // for kill, sigprocmask
+#include <cstring> // for strerror
+#include <filesystem>
+#include <iostream>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace std;
+
+// Silence after which a worker is declared dead (several missed heartbeats)
+const int WORKER_TIMEOUT_MS = 6 * HEARTBEAT_MS;
+// Dead workers a submission may see before it is given up
+const int MAX_ATTEMPTS = 3;
+
+Coordinator::Coordinator(const string &socket_path)
+    : socket_path(socket_path) {}
+
+Coordinator::~Coordinator() {
+    if (loop.joinable()) {
+        {
+            lock_guard<std::mutex> lock(mutex);
+            stop = true;
+        }
+        uint64_t one = 1;
+        ssize_t written = write(wake_fd, &one, sizeof(one));
+        (void)written;
+        loop.join();
+    }
+    // Workers exit when their connection closes
+    for (auto &entry : workers)
+        close(entry.first);
+    for (pid_t pid : local_workers)
+        waitpid(pid, nullptr, 0);
+    for (int fd : {listen_fd, wake_fd})
+        if (fd >= 0)
+            close(fd);
+    if (listen_fd >= 0)
+        unlink(socket_path.c_str());
+}
+
+bool Coordinator::start() {
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if (socket_path.size() >= sizeof(address.sun_path)) {
+        cerr << "Socket path too long: " << socket_path << '\n';
+        return false;
+    }
+    strcpy(address.sun_path, socket_path.c_str());
+    unlink(socket_path.c_str());
+    listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listen_fd < 0 ||
+        bind(listen_fd, (sockaddr *)&address, sizeof(address)) < 0 ||
+        listen(listen_fd, 64) < 0) {
+        cerr << "Cannot listen on " << socket_path << ": " << strerror(errno)
+             << '\n';
+        return false;
+    }
+    wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    loop = thread(&Coordinator::eventLoop, this);
+    return true;
+}
+
+void Coordinator::spawnLocalWorkers(int count, int threads,
+                                    const vector<string> &judge_args) {
+    vector<string> args = {"OJ", "--worker", socket_path, "--threads",
+                           to_string(threads)};
+    args.insert(args.end(), judge_args.begin(), judge_args.end());
+    vector<char *> argv;
+    for (string &arg : args)
+        argv.push_back(&arg[0]);
+    argv.push_back(nullptr);
+
+    for (int i = 0; i < count; i++) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            sigset_t none;
+            sigemptyset(&none);
+            sigprocmask(SIG_SETMASK, &none, nullptr);
+            execv("/proc/self/exe", argv.data());
+            _exit(127);
+        }
+        if (pid > 0) {
+            lock_guard<std::mutex> lock(mutex);
+            local_workers.push_back(pid);
+        }
+    }
+}
+
+future<void> Coordinator::submit(int task_id, const string &source,
+                                 const string &problem,
+                                 SubmissionTimes *times,
+                                 function<void()> on_done) {
+    Job job;
+    job.task_id = task_id;
+    job.source = source;
+    job.problem = problem;
+    job.times = times;
+    job.on_done = move(on_done);
+    job.done = make_shared<promise<void>>();
+    future<void> result = job.done->get_future();
+    {
+        lock_guard<std::mutex> lock(mutex);
+        outstanding++;
+        queue.push_back(move(job));
+    }
+    uint64_t one = 1;
+    ssize_t written = write(wake_fd, &one, sizeof(one));
+    (void)written;
+    return result;
+}
+
+void Coordinator::wait_idle() {
+    unique_lock<std::mutex> lock(mutex);
+    idle_condition.wait(lock, [this] { return outstanding == 0; });
+}
+
+void Coordinator::report(ostream &out) {
+    lock_guard<std::mutex> lock(mutex);
+    out << "Workers: " << workers.size() << " connected, " << workers_lost
+        << " lost, " << requeued << " submissions requeued\n";
+}
+
+void Coordinator::eventLoop() {
+    uint64_t wakeups;
+    while (true) {
+        vector<pollfd> fds = {{wake_fd, POLLIN, 0}, {listen_fd, POLLIN, 0}};
+        {
+            lock_guard<std::mutex> lock(mutex);
+            if (stop)
+                return;
+            for (auto &entry : workers)
+                fds.push_back({entry.first,
+                               (short)(entry.second.output.empty()
+                                           ? POLLIN
+                                           : POLLIN | POLLOUT),
+                               0});
+        }
+        poll(fds.data(), fds.size(), HEARTBEAT_MS);
+
+        if (fds[0].revents & POLLIN) {
+            ssize_t got = read(wake_fd, &wakeups, sizeof(wakeups));
+            (void)got;
+        }
+        if (fds[1].revents & POLLIN)
+            acceptWorker();
+
+        lock_guard<std::mutex> lock(mutex);
+        if (stop)
+            return;
+        for (size_t i = 2; i < fds.size(); i++) {
+            if (!fds[i].revents)
+                continue;
+            auto it = workers.find(fds[i].fd);
+            if (it == workers.end())
+                continue;
+            if ((fds[i].revents & POLLOUT) && !flushTo(it->second))
+                dropWorker(fds[i].fd, "unreachable");
+            else if ((fds[i].revents & ~POLLOUT) && !readFrom(it->second))
+                dropWorker(fds[i].fd, "disconnected");
+        }
+
+        auto now = chrono::steady_clock::now();
+        vector<int> silent;
+        for (auto &entry : workers)
+            if (now - entry.second.last_seen >
+                chrono::milliseconds(WORKER_TIMEOUT_MS))
+                silent.push_back(entry.first);
+        for (int fd : silent)
+            dropWorker(fd, "timed out");
+
+        // Reap local workers that died, so they are not left as zombies
+        for (size_t i = 0; i < local_workers.size();) {
+            if (waitpid(local_workers[i], nullptr, WNOHANG) > 0)
+                local_workers.erase(local_workers.begin() + i);
+            else
+                i++;
+        }
+        // Nobody left to judge what is queued
+        if (workers.empty() && local_workers.empty()) {
+            while (!queue.empty()) {
+                Job job = move(queue.front());
+                queue.pop_front();
+                job.attempts = MAX_ATTEMPTS;
+                finish(job);
+            }
+        }
+
+        dispatch();
+    }
+}
+
+void Coordinator::acceptWorker() {
+    int fd = accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+    if (fd < 0)
+        return;
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    lock_guard<std::mutex> lock(mutex);
+    Worker &worker = workers[fd];
+    worker.fd = fd;
+    worker.last_seen = chrono::steady_clock::now();
+}
+
+bool Coordinator::readFrom(Worker &worker) {
+    char chunk[65536];
+    while (true) {
+        ssize_t n = read(worker.fd, chunk, sizeof(chunk));
+        if (n > 0) {
+            worker.input.append(chunk, n);
+            continue;
+        }
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            break;
+        return false; // EOF or error
+    }
+    worker.last_seen = chrono::steady_clock::now();
+
+    MessageType type;
+    string payload;
+    bool broken = false;
+    while (takeMessage(worker.input, type, payload, broken)) {
+        WireReader in(payload);
+        if (type == MessageType::HELLO) {
+            worker.capacity = (int)in.u32();
+            worker.pid = (pid_t)in.u32();
+            cout << "Worker " << worker.pid << " joined with "
+                 << worker.capacity << " slots" << endl;
+        } else if (type == MessageType::RESULT) {
+            ResultRecord record;
+            if (!decodeRecord(in, record))
+                return false;
+            auto it = worker.running.find(record.task_id);
+            if (it == worker.running.end())
+                continue;
+            Job job = move(it->second);
+            worker.running.erase(it);
+            if (job.times) {
+                job.times->compiled = record.verdict != "CE";
+                if (!job.times->compiled)
+                    job.times->compile_end = chrono::steady_clock::now();
+            }
+            resultLog().log(move(record));
+            finish(job);
+        }
+        // HEARTBEAT: last_seen is all it is for
+    }
+    return !broken;
+}
+
+// Caller holds mutex
+bool Coordinator::flushTo(Worker &worker) {
+    size_t sent = 0;
+    while (sent < worker.output.size()) {
+        ssize_t n = send(worker.fd, worker.output.data() + sent,
+                         worker.output.size() - sent, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            break; // the rest goes on POLLOUT
+        if (n <= 0)
+            return false;
+        sent += n;
+    }
+    worker.output.erase(0, sent);
+    return true;
+}
+
+// Caller holds mutex
+void Coordinator::dropWorker(int fd, const char *why) {
+    auto it = workers.find(fd);
+    if (it == workers.end())
+        return;
+    Worker &worker = it->second;
+    cerr << "Worker " << worker.pid << " " << why << ", requeueing "
+         << worker.running.size() << " submissions\n";
+    for (auto &entry : worker.running) {
+        Job &job = entry.second;
+        if (job.attempts >= MAX_ATTEMPTS) {
+            finish(job);
+        } else {
+            requeued++;
+            queue.push_front(move(job));
+        }
+    }
+    // A hung local worker would otherwise keep its runs going; a dead one
+    // cannot clean up its scratch directory
+    for (pid_t pid : local_workers) {
+        if (pid == worker.pid) {
+            kill(pid, SIGKILL);
+            error_code ec;
+            std::filesystem::remove_all(workerScratchDir(pid), ec);
+        }
+    }
+    close(fd);
+    workers.erase(it);
+    workers_lost++;
+}
+
+// Caller holds mutex. A job that ran out of attempts gets an "IE" verdict.
+void Coordinator::finish(Job &job) {
+    if (job.attempts >= MAX_ATTEMPTS) {
+        ResultRecord record;
+        record.task_id = job.task_id;
+        record.problem = job.problem;
+        record.verdict = "IE";
+        resultLog().log(move(record));
+    }
+    if (job.times)
+        job.times->done = chrono::steady_clock::now();
+    if (job.on_done)
+        job.on_done();
+    job.done->set_value();
+    if (--outstanding == 0)
+        idle_condition.notify_all();
+}
+
+// Caller holds mutex
+void Coordinator::dispatch() {
+    while (!queue.empty()) {
+        // The worker with the most free slots
+        Worker *best = nullptr;
+        int best_free = 0;
+        for (auto &entry : workers) {
+            Worker &worker = entry.second;
+            int free = worker.capacity - (int)worker.running.size();
+            if (free > best_free) {
+                best = &worker;
+                best_free = free;
+            }
+        }
+        if (!best)
+            return;
+
+        Job job = move(queue.front());
+        queue.pop_front();
+        job.attempts++;
+        if (job.times)
+            job.times->compile_start = job.times->compile_end =
+                job.times->run_start = chrono::steady_clock::now();
+
+        WireWriter out;
+        out.u32((uint32_t)job.task_id);
+        out.str(job.problem);
+        out.str(job.source);
+        best->running[job.task_id] = move(job);
+        // Sent now if the socket has room, else from the event loop; a
+        // failed send means the worker is gone and the job is requeued
+        best->output += encodeMessage(MessageType::JOB, out.payload());
+        if (!flushTo(*best))
+            dropWorker(best->fd, "unreachable");
+    }
+}
@@ -0,0 +1,123 @@
+// coordinator.h
+#ifndef COORDINATOR_H
+#define COORDINATOR_H
+
+#include "load_report.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <iosfwd>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/types.h> // for pid_t
+
+/*
+ * Judging in separate worker processes.
+ *
+ * Workers (`OJ --worker <socket>`, see worker.h) connect to the
+ * coordinator's Unix socket, say how many submissions they judge at once
+ * and then receive jobs over the wire protocol of wire.h. Each worker keeps
+ * its executables and outputs in its own scratch directory, and a crashing
+ * worker takes only its own submissions down: those are requeued to the
+ * other workers.
+ *
+ * A worker counts as dead when its connection closes or it has not sent
+ * anything (results or heartbeats) for WORKER_TIMEOUT_MS. A submission that
+ * has been on MAX_ATTEMPTS dead workers is given up with the verdict "IE"
+ * (internal error) instead of taking down every worker in turn.
+ *
+ * Jobs go to the worker with the most free slots, so faster or bigger
+ * workers take more of the load. Verdicts are written to the result log.
+ * Worker sockets are non-blocking: frames a worker is not ready for wait in
+ * its output buffer, so one slow reader never stalls the event loop.
+ */
+class Coordinator {
+  private:
+    struct Job {
+        int task_id;
+        std::string source;
+        std::string problem;
+        int attempts = 0;
+        SubmissionTimes *times = nullptr;
+        std::function<void()> on_done;
+        std::shared_ptr<std::promise<void>> done;
+    };
+
+    struct Worker {
+        int fd;
+        pid_t pid = 0;    // as reported in HELLO
+        int capacity = 0; // 0 until HELLO
+        std::string input;
+        std::string output; // frames not written yet, flushed on POLLOUT
+        std::map<int, Job> running;
+        std::chrono::steady_clock::time_point last_seen;
+    };
+
+    std::string socket_path;
+    int listen_fd = -1;
+    int wake_fd = -1;
+    bool stop = false;
+    std::thread loop;
+
+    // Everything below is guarded by mutex
+    std::mutex mutex;
+    std::condition_variable idle_condition;
+    std::deque<Job> queue;
+    std::map<int, Worker> workers; // by socket fd
+    size_t outstanding = 0;        // submitted and not finished
+    size_t workers_lost = 0;
+    size_t requeued = 0;
+    std::vector<pid_t> local_workers;
+
+    void eventLoop();
+    void acceptWorker();
+    // Returns false if the worker sent garbage
+    bool readFrom(Worker &worker);
+    // Write what the socket takes of worker.output without blocking;
+    // false if the worker is gone
+    bool flushTo(Worker &worker);
+    void dropWorker(int fd, const char *why);
+    void finish(Job &job);
+    void dispatch();
+
+  public:
+    explicit Coordinator(const std::string &socket_path);
+    ~Coordinator();
+    Coordinator(const Coordinator &) = delete;
+    Coordinator &operator=(const Coordinator &) = delete;
+
+    // Listen and start the event loop; false if the socket cannot be bound
+    bool start();
+
+    // Start `count` worker processes of this binary on this machine, each
+    // running `threads` submissions at once, with `judge_args` (judge
+    // options such as --stream) passed on
+    void spawnLocalWorkers(int count, int threads,
+                           const std::vector<std::string> &judge_args);
+
+    // Judge `source` for `problem` on some worker. The future becomes ready
+    // once the verdict is logged. `times` (optional) gets the moment it was
+    // sent to a worker as compile_start (and run_start), and its end as done.
+    // `on_done` (optional) is called once it has its verdict, under the
+    // coordinator's lock.
+    std::future<void> submit(int task_id, const std::string &source,
+                             const std::string &problem,
+                             SubmissionTimes *times = nullptr,
+                             std::function<void()> on_done = nullptr);
+
+    // Block until every submission has a verdict
+    void wait_idle();
+
+    // Workers connected and lost, submissions requeued
+    void report(std::ostream &out);
+};
+
+#endif // COORDINATOR_H
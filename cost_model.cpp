@@ -0,0 +1,93 @@
+#include "cost_model.h"
+
+#include <filesystem> // for creating the parent directory
+#include <fstream>
+
+#include <fcntl.h>    // for open
+#include <sys/file.h> // for flock
+#include <unistd.h>   // for getpid, close
+
+using namespace std;
+namespace fs = std::filesystem;
+
+// Weight of the newest sample in the moving average
+const double COST_ALPHA = 0.3;
+
+double CostModel::expected(const string &key,
+                           const string &fallback_key) const {
+    lock_guard<mutex> lock(model_mutex);
+    auto it = estimates.find(key);
+    if (it == estimates.end() && !fallback_key.empty())
+        it = estimates.find(fallback_key);
+    return it == estimates.end() ? 0 : it->second.mean_ms;
+}
+
+void CostModel::update(Estimate &estimate, double duration_ms) {
+    if (estimate.samples == 0)
+        estimate.mean_ms = duration_ms;
+    else
+        estimate.mean_ms += COST_ALPHA * (duration_ms - estimate.mean_ms);
+    estimate.samples++;
+}
+
+void CostModel::record(const string &key, double duration_ms) {
+    lock_guard<mutex> lock(model_mutex);
+    update(estimates[key], duration_ms);
+    unsaved[key].push_back(duration_ms);
+}
+
+void CostModel::load(const string &path) {
+    ifstream in(path);
+    string key;
+    double mean_ms;
+    long samples;
+    lock_guard<mutex> lock(model_mutex);
+    while (in >> key >> mean_ms >> samples)
+        estimates[key] = {mean_ms, samples};
+}
+
+void CostModel::save(const string &path) {
+    lock_guard<mutex> lock(model_mutex);
+    if (unsaved.empty())
+        return;
+    error_code ec;
+    fs::create_directories(fs::path(path).parent_path(), ec);
+    // One saver at a time, so no process's samples are lost
+    int lock_fd = open((path + ".lock").c_str(), O_RDWR | O_CREAT | O_CLOEXEC,
+                       0644);
+    if (lock_fd >= 0)
+        flock(lock_fd, LOCK_EX);
+
+    map<string, Estimate> merged;
+    {
+        ifstream in(path);
+        string key;
+        double mean_ms;
+        long samples;
+        while (in >> key >> mean_ms >> samples)
+            merged[key] = {mean_ms, samples};
+    }
+    for (const auto &added : unsaved)
+        for (double duration_ms : added.second)
+            update(merged[added.first], duration_ms);
+
+    string tmp = path + "." + to_string(getpid()) + ".tmp";
+    bool written;
+    {
+        ofstream out(tmp);
+        for (const auto &entry : merged)
+            out << entry.first << ' ' << entry.second.mean_ms << ' '
+                << entry.second.samples << '\n';
+        written = (bool)out.flush();
+    }
+    if (written)
+        fs::rename(tmp, path, ec);
+    if (!written || ec) {
+        fs::remove(tmp, ec);
+    } else {
+        estimates = merged;
+        unsaved.clear();
+    }
+    if (lock_fd >= 0)
+        close(lock_fd); // releases the flock
+}
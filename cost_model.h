@@ -0,0 +1,45 @@
+// cost_model.h
+#ifndef COST_MODEL_H
+#define COST_MODEL_H
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/*
+ * Historical job durations, used to estimate how long a queued task will
+ * take. Durations are kept as an exponentially weighted moving average per
+ * key and survive restarts through a small text file.
+ */
+class CostModel {
+  private:
+    struct Estimate {
+        double mean_ms = 0;
+        long samples = 0;
+    };
+
+    std::map<std::string, Estimate> estimates;
+    // Durations recorded since the last save, in order, replayed onto the
+    // file by the next one
+    std::map<std::string, std::vector<double>> unsaved;
+    mutable std::mutex model_mutex;
+
+    static void update(Estimate &estimate, double duration_ms);
+
+  public:
+    // Expected duration for `key`, falling back to `fallback_key` and then
+    // to 0 (unknown jobs are tried early, which is how they get measured)
+    double expected(const std::string &key,
+                    const std::string &fallback_key = "") const;
+
+    void record(const std::string &key, double duration_ms);
+
+    // "<key> <mean_ms> <samples>" per line; missing files are not an error.
+    // Like TestStats, save() merges into the file as it is now and replaces
+    // it with rename().
+    void load(const std::string &path);
+    void save(const std::string &path);
+};
+
+#endif // COST_MODEL_H
@@ -0,0 +1,315 @@
+#include "daemon.h"
+#include "problems.h"
+#include "result_log.h"
+
+#include <algorithm> // for min, max
+#include <cerrno>
+#include <cstring> // for strerror
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+#include <csignal>
+#include <fcntl.h> // for O_NONBLOCK
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace std;
+namespace fs = std::filesystem;
+
+const string JOB_SUFFIX = ".sub";
+const size_t MAX_REQUEST_BYTES = 4096;
+// Time a socket client has to send its whole request line
+const int CLIENT_REQUEST_MS = 1000;
+
+static string errorJson(const string &message) {
+    return "{\"error\": \"" + message + "\"}";
+}
+
+static sigset_t stopSignals() {
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    return signals;
+}
+
+void JudgeDaemon::blockStopSignals() {
+    sigset_t signals = stopSignals();
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+}
+
+JudgeDaemon::JudgeDaemon(const string &spool_dir, const string &socket_path,
+                         Submit submit)
+    : spool_dir(spool_dir), outbox_dir(spool_dir + "/outbox"),
+      socket_path(socket_path), submit(move(submit)) {}
+
+JudgeDaemon::~JudgeDaemon() {
+    // The result log is closed by now, nothing is delivered any more
+    resultLog().setListener(nullptr);
+    for (auto &entry : pending)
+        if (entry.second.client_fd >= 0)
+            close(entry.second.client_fd);
+    for (auto &client : clients)
+        close(client.first);
+    for (int fd : {inotify_fd, listen_fd, signal_fd})
+        if (fd >= 0)
+            close(fd);
+    if (listen_fd >= 0)
+        unlink(socket_path.c_str());
+}
+
+// Hand a verdict (or an error) to whoever is waiting for it
+static void writeTo(const string &outbox_file, int client_fd,
+                    const string &json) {
+    if (client_fd >= 0) {
+        string line = json + '\n';
+        ssize_t sent = send(client_fd, line.data(), line.size(), MSG_NOSIGNAL);
+        (void)sent;
+        close(client_fd);
+        return;
+    }
+    // Readers of the outbox only ever see complete files
+    string tmp = outbox_file + ".tmp";
+    {
+        ofstream out(tmp);
+        out << json << '\n';
+    }
+    rename(tmp.c_str(), outbox_file.c_str());
+}
+
+bool JudgeDaemon::startTask(const string &request, Pending where) {
+    istringstream in(request);
+    string problem, source;
+    if (!(in >> problem >> source)) {
+        writeTo(where.outbox_file, where.client_fd,
+                errorJson("expected: <problem> <source path>"));
+        return false;
+    }
+    if (!problemRegistry().get(problem)) {
+        writeTo(where.outbox_file, where.client_fd,
+                errorJson("unknown problem"));
+        return false;
+    }
+    if (!fs::is_regular_file(source)) {
+        writeTo(where.outbox_file, where.client_fd,
+                errorJson("source not found"));
+        return false;
+    }
+
+    int task_id = next_task_id++;
+    {
+        lock_guard<mutex> lock(pending_mutex);
+        pending[task_id] = where;
+    }
+    submit(task_id, source, problem);
+    return true;
+}
+
+void JudgeDaemon::takeJob(const string &name) {
+    if (name.size() <= JOB_SUFFIX.size() ||
+        name.compare(name.size() - JOB_SUFFIX.size(), JOB_SUFFIX.size(),
+                     JOB_SUFFIX) != 0)
+        return;
+    string path = spool_dir + "/" + name;
+    ifstream job(path);
+    if (!job)
+        return; // already taken (seen by both the scan and inotify)
+    string request;
+    getline(job, request);
+    job.close();
+    // Whoever removes it owns the job
+    if (unlink(path.c_str()) != 0)
+        return;
+
+    Pending where;
+    where.outbox_file = outbox_dir + "/" +
+                        name.substr(0, name.size() - JOB_SUFFIX.size()) +
+                        ".json";
+    startTask(request, where);
+}
+
+void JudgeDaemon::scanSpool() {
+    error_code ec;
+    for (const auto &entry : fs::directory_iterator(spool_dir, ec))
+        if (entry.is_regular_file())
+            takeJob(entry.path().filename().string());
+}
+
+void JudgeDaemon::acceptClient() {
+    int fd = accept4(listen_fd, nullptr, nullptr,
+                     SOCK_CLOEXEC | SOCK_NONBLOCK);
+    if (fd < 0)
+        return;
+    // A client sends its line right after connecting; the event loop reads
+    // it as it comes, so a slow one holds up no one
+    Client &client = clients[fd];
+    client.deadline = chrono::steady_clock::now() +
+                      chrono::milliseconds(CLIENT_REQUEST_MS);
+    readClient(fd);
+}
+
+void JudgeDaemon::readClient(int fd) {
+    Client &client = clients[fd];
+    bool complete = false;
+    char chunk[512];
+    while (!complete) {
+        ssize_t n = read(fd, chunk, sizeof(chunk));
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return; // the rest comes later
+        if (n <= 0) {
+            complete = true; // closed its end: take what it sent
+            break;
+        }
+        client.request.append(chunk, n);
+        size_t newline = client.request.find('\n');
+        if (newline != string::npos) {
+            client.request.resize(newline);
+            complete = true;
+        } else if (client.request.size() >= MAX_REQUEST_BYTES) {
+            client.request.resize(MAX_REQUEST_BYTES);
+            complete = true;
+        }
+    }
+
+    // The verdict goes back with a blocking send, like before
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_NONBLOCK);
+    string request = move(client.request);
+    clients.erase(fd);
+    Pending where;
+    where.client_fd = fd;
+    startTask(request, where);
+}
+
+void JudgeDaemon::expireClients() {
+    auto now = chrono::steady_clock::now();
+    for (auto it = clients.begin(); it != clients.end();) {
+        if (it->second.deadline > now) {
+            ++it;
+            continue;
+        }
+        int fd = it->first;
+        it = clients.erase(it);
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_NONBLOCK);
+        writeTo("", fd, errorJson("request not sent in time"));
+    }
+}
+
+int JudgeDaemon::msUntilDeadline() const {
+    if (clients.empty())
+        return -1;
+    auto first = clients.begin()->second.deadline;
+    for (const auto &client : clients)
+        first = min(first, client.second.deadline);
+    auto left = chrono::duration_cast<chrono::milliseconds>(
+                    first - chrono::steady_clock::now())
+                    .count();
+    return (int)max<long long>(left + 1, 0);
+}
+
+void JudgeDaemon::deliver(const ResultRecord &record) {
+    Pending where;
+    {
+        lock_guard<mutex> lock(pending_mutex);
+        auto it = pending.find(record.task_id);
+        if (it == pending.end())
+            return;
+        where = it->second;
+        pending.erase(it);
+    }
+    writeTo(where.outbox_file, where.client_fd, resultJson(record));
+}
+
+bool JudgeDaemon::run() {
+    error_code ec;
+    fs::create_directories(outbox_dir, ec);
+    if (ec) {
+        cerr << "Cannot create " << outbox_dir << ": " << ec.message() << '\n';
+        return false;
+    }
+
+    inotify_fd = inotify_init1(IN_CLOEXEC);
+    if (inotify_fd < 0 ||
+        inotify_add_watch(inotify_fd, spool_dir.c_str(),
+                          IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+        cerr << "Cannot watch " << spool_dir << ": " << strerror(errno)
+             << '\n';
+        return false;
+    }
+
+    sigset_t signals = stopSignals();
+    signal_fd = signalfd(-1, &signals, SFD_CLOEXEC);
+
+    if (!socket_path.empty()) {
+        sockaddr_un address = {};
+        address.sun_family = AF_UNIX;
+        if (socket_path.size() >= sizeof(address.sun_path)) {
+            cerr << "Socket path too long: " << socket_path << '\n';
+            return false;
+        }
+        strcpy(address.sun_path, socket_path.c_str());
+        unlink(socket_path.c_str());
+        listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (listen_fd < 0 ||
+            bind(listen_fd, (sockaddr *)&address, sizeof(address)) < 0 ||
+            listen(listen_fd, 64) < 0) {
+            cerr << "Cannot listen on " << socket_path << ": "
+                 << strerror(errno) << '\n';
+            return false;
+        }
+    }
+
+    resultLog().setListener(
+        [this](const ResultRecord &record) { deliver(record); });
+
+    cout << "Judge daemon watching " << spool_dir;
+    if (listen_fd >= 0)
+        cout << " and listening on " << socket_path;
+    cout << endl;
+
+    // Jobs dropped before the watch existed
+    scanSpool();
+
+    alignas(inotify_event) char events[4096];
+    while (true) {
+        vector<pollfd> fds = {{inotify_fd, POLLIN, 0},
+                              {signal_fd, POLLIN, 0},
+                              {listen_fd, POLLIN, 0}};
+        for (const auto &client : clients)
+            fds.push_back({client.first, POLLIN, 0});
+        if (poll(fds.data(), fds.size(), msUntilDeadline()) < 0) {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+        if (fds[1].revents & POLLIN)
+            break;
+        for (size_t k = 3; k < fds.size(); k++)
+            if (fds[k].revents)
+                readClient(fds[k].fd);
+        expireClients();
+        if (fds[2].revents & POLLIN)
+            acceptClient();
+        if (fds[0].revents & POLLIN) {
+            ssize_t size = read(inotify_fd, events, sizeof(events));
+            for (ssize_t at = 0; at < size;) {
+                const inotify_event *event = (inotify_event *)(events + at);
+                if (event->mask & IN_Q_OVERFLOW)
+                    scanSpool();
+                else if (event->len > 0)
+                    takeJob(event->name);
+                at += sizeof(inotify_event) + event->len;
+            }
+        }
+    }
+    cout << "Judge daemon stopping" << endl;
+    return true;
+}
@@ -0,0 +1,87 @@
+// daemon.h
+#ifndef DAEMON_H
+#define DAEMON_H
+
+#include <chrono>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+
+struct ResultRecord;
+
+/*
+ * Long-running judge: the pools, the problem registry and the compile cache
+ * stay warm, and submissions come in while it runs.
+ *
+ * Spool: a submission is a file <spool>/<name>.sub holding
+ *      <problem> <source path>
+ * (write it elsewhere and rename it in, or close it once written). The
+ * daemon picks it up through inotify, removes it and later writes the
+ * verdict as JSON to <spool>/outbox/<name>.json.
+ *
+ * Socket: with a socket path, clients may also connect to that Unix socket,
+ * send the same "<problem> <source path>" line and read back the verdict as
+ * one JSON line. Clients are read without blocking alongside the spool; one
+ * that has not sent its whole line within CLIENT_REQUEST_MS gets an error.
+ *
+ * SIGINT or SIGTERM stop the daemon from taking new submissions.
+ */
+class JudgeDaemon {
+  public:
+    // Start judging `source` for `problem` as task `task_id`
+    typedef std::function<void(int task_id, const std::string &source,
+                               const std::string &problem)>
+        Submit;
+
+  private:
+    // Where the verdict of a task goes: an outbox file or a client
+    struct Pending {
+        std::string outbox_file;
+        int client_fd = -1;
+    };
+
+    std::string spool_dir, outbox_dir, socket_path;
+    Submit submit;
+    int inotify_fd = -1, listen_fd = -1, signal_fd = -1;
+    int next_task_id = 0;
+
+    std::mutex pending_mutex;
+    std::map<int, Pending> pending;
+
+    // Socket clients still sending their request line, by fd; only the
+    // event loop touches them
+    struct Client {
+        std::string request;
+        std::chrono::steady_clock::time_point deadline;
+    };
+    std::map<int, Client> clients;
+
+    void scanSpool();
+    void takeJob(const std::string &name);
+    void acceptClient();
+    void readClient(int fd);
+    void expireClients();
+    int msUntilDeadline() const; // for poll(), -1 when no client waits
+    bool startTask(const std::string &request, Pending where);
+    // Called on the result log's writer thread
+    void deliver(const ResultRecord &record);
+
+  public:
+    JudgeDaemon(const std::string &spool_dir, const std::string &socket_path,
+                Submit submit);
+    ~JudgeDaemon();
+    JudgeDaemon(const JudgeDaemon &) = delete;
+    JudgeDaemon &operator=(const JudgeDaemon &) = delete;
+
+    // Block SIGINT and SIGTERM so run() can wait for them; call before
+    // any other thread is started, as threads inherit the mask
+    static void blockStopSignals();
+
+    // Take submissions until SIGINT or SIGTERM; false if the spool or the
+    // socket cannot be set up. Submissions already started keep running
+    // and are delivered as long as the daemon object is alive.
+    bool run();
+};
+
+#endif // DAEMON_H
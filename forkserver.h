@@ -0,0 +1,52 @@
+// forkserver.h
+#ifndef FORKSERVER_H
+#define FORKSERVER_H
+
+/*
+ * Protocol between the judge (runner.cpp) and the fork-server shim
+ * (forkserver_shim.cpp) linked into participant binaries. Both sides are
+ * built on the same host, so the messages are plain structs sent over a
+ * SOCK_SEQPACKET socketpair.
+ *
+ * The judge starts the binary with FORK_SERVER_ENV set to the number of its
+ * end of the socketpair. Once static initialization is done, the shim's
+ * main() sends READY and then, per test:
+ *      judge -> shim   ForkRequest, with stdin and stdout attached as
+ *                      SCM_RIGHTS
+ *      shim -> judge   ForkStarted: the copy has been forked
+ *      judge -> shim   one byte, once it watches the pid (until then the
+ *                      shim does not reap the copy, so the pid is not
+ *                      reused under the judge)
+ *      shim -> judge   ForkFinished: wait4() status and rusage of the copy
+ * The copy runs the participant's real main() in its own process group
+ * with the requested limits. The server exits when the socket closes.
+ *
+ * Without FORK_SERVER_ENV the shim just calls the real main(), so a binary
+ * built for the fork server also runs as a plain program.
+ */
+
+#include <cstdint>
+
+#include <sys/resource.h> // for rusage
+#include <sys/types.h>    // for pid_t
+
+#define FORK_SERVER_ENV "OJ_FORK_SERVER_FD"
+
+const char FORK_SERVER_READY = 'R';
+
+struct ForkRequest {
+    int64_t memory_limit_bytes; // RLIMIT_AS, 0 = none
+    int64_t cpu_limit_seconds;  // RLIMIT_CPU, 0 = none
+    int64_t output_limit_bytes; // RLIMIT_FSIZE, 0 = none
+};
+
+struct ForkStarted {
+    pid_t pid; // -1 if fork failed
+};
+
+struct ForkFinished {
+    int status;
+    struct rusage usage;
+};
+
+#endif // FORKSERVER_H
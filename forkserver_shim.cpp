@@ -0,0 +1,122 @@
+// Fork-server shim, linked into participant binaries with
+// -Wl,--wrap=main when the judge runs in fork-server mode (see
+// forkserver.h). The dynamic loader, libstdc++ and the participant's static
+// initializers run once; each test is then a fork of the initialized
+// process.
+
+#include "forkserver.h"
+
+#include <cerrno>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern "C" int __real_main(int argc, char **argv, char **envp);
+
+// A request and the two descriptors that come with it
+static bool receiveRequest(int control, ForkRequest &request, int &in_fd,
+                           int &out_fd) {
+    char space[CMSG_SPACE(2 * sizeof(int))];
+    iovec data = {&request, sizeof(request)};
+    msghdr message = {};
+    message.msg_iov = &data;
+    message.msg_iovlen = 1;
+    message.msg_control = space;
+    message.msg_controllen = sizeof(space);
+
+    ssize_t got;
+    while ((got = recvmsg(control, &message, MSG_CMSG_CLOEXEC)) < 0 &&
+           errno == EINTR) {
+    }
+    cmsghdr *header = CMSG_FIRSTHDR(&message);
+    if (got != (ssize_t)sizeof(request) || !header ||
+        header->cmsg_type != SCM_RIGHTS ||
+        header->cmsg_len != CMSG_LEN(2 * sizeof(int)))
+        return false;
+    int fds[2];
+    memcpy(fds, CMSG_DATA(header), sizeof(fds));
+    in_fd = fds[0];
+    out_fd = fds[1];
+    return true;
+}
+
+static void setLimit(int resource, int64_t value) {
+    if (value <= 0)
+        return;
+    rlimit limit = {(rlim_t)value, (rlim_t)value};
+    setrlimit(resource, &limit);
+}
+
+extern "C" int __wrap_main(int argc, char **argv, char **envp) {
+    const char *fd_text = getenv(FORK_SERVER_ENV);
+    if (!fd_text)
+        return __real_main(argc, argv, envp);
+    int control = atoi(fd_text);
+    // The copies see the same environment as a plain run
+    unsetenv(FORK_SERVER_ENV);
+
+    if (send(control, &FORK_SERVER_READY, 1, MSG_NOSIGNAL) != 1)
+        _exit(1);
+
+    while (true) {
+        ForkRequest request;
+        int in_fd, out_fd;
+        if (!receiveRequest(control, request, in_fd, out_fd))
+            _exit(0); // the judge is done with us
+
+        pid_t pid = fork();
+        if (pid == 0) {
+            close(control);
+            setpgid(0, 0);
+            setLimit(RLIMIT_AS, request.memory_limit_bytes);
+            if (request.cpu_limit_seconds > 0) {
+                rlimit cpu = {(rlim_t)request.cpu_limit_seconds,
+                              (rlim_t)request.cpu_limit_seconds + 1};
+                setrlimit(RLIMIT_CPU, &cpu);
+            }
+            setLimit(RLIMIT_FSIZE, request.output_limit_bytes);
+            if (dup2(in_fd, STDIN_FILENO) < 0 ||
+                dup2(out_fd, STDOUT_FILENO) < 0)
+                _exit(127);
+            close(in_fd);
+            close(out_fd);
+            // exit(), not _exit(): flush stdio and run destructors exactly
+            // as returning from main would
+            exit(__real_main(argc, argv, environ));
+        }
+        if (pid > 0)
+            setpgid(pid, pid);
+        close(in_fd);
+        close(out_fd);
+
+        ForkStarted started = {pid};
+        if (send(control, &started, sizeof(started), MSG_NOSIGNAL) !=
+            (ssize_t)sizeof(started)) {
+            if (pid > 0)
+                kill(-pid, SIGKILL);
+            _exit(0);
+        }
+        if (pid < 0)
+            continue;
+
+        // Keep the copy unreaped until the judge has a handle on it
+        char ack;
+        if (recv(control, &ack, 1, 0) != 1) {
+            kill(-pid, SIGKILL);
+            waitpid(pid, nullptr, 0);
+            _exit(0);
+        }
+
+        ForkFinished finished = {};
+        while (wait4(pid, &finished.status, 0, &finished.usage) < 0 &&
+               errno == EINTR) {
+        }
+        if (send(control, &finished, sizeof(finished), MSG_NOSIGNAL) !=
+            (ssize_t)sizeof(finished))
+            _exit(0);
+    }
+}
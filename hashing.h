@@ -0,0 +1,40 @@
+// hashing.h
+#ifndef HASHING_H
+#define HASHING_H
+
+#include <cstdint>
+#include <sstream>
+#include <string>
+
+const uint64_t FNV_OFFSET = 1469598103934665603ull;
+
+// FNV-1a, good enough to address a few thousand files. Chain calls by
+// passing the previous result as `hash`.
+inline uint64_t fnv1a(const char *data, size_t size,
+                      uint64_t hash = FNV_OFFSET) {
+    for (size_t i = 0; i < size; i++) {
+        hash ^= (unsigned char)data[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+inline uint64_t fnv1a(const std::string &data, uint64_t hash = FNV_OFFSET) {
+    return fnv1a(data.data(), data.size(), hash);
+}
+
+// SHA-256 as 64 hex digits, for keys of content that participants control
+// (sources, binaries): unlike FNV-1a, no one can make two of them collide
+std::string sha256Hex(const char *data, size_t size);
+
+inline std::string sha256Hex(const std::string &data) {
+    return sha256Hex(data.data(), data.size());
+}
+
+inline std::string toHex(uint64_t hash) {
+    std::ostringstream out;
+    out << std::hex << hash;
+    return out.str();
+}
+
+#endif // HASHING_H
@@ -0,0 +1,113 @@
+#include "ingest.h"
+
+#include <algorithm> // for std::max
+#include <thread>    // for sleep_until
+
+using namespace std;
+
+TimerWheel::TimerWheel(double tick_ms, size_t num_slots)
+    : start(clock::now()), tick_ms(tick_ms), slots(max<size_t>(num_slots, 1)) {
+}
+
+TimerWheel::clock::time_point TimerWheel::timeOf(uint64_t tick) const {
+    return start + chrono::duration_cast<clock::duration>(
+                       chrono::duration<double, milli>(tick * tick_ms));
+}
+
+void TimerWheel::schedule(double at_ms, function<void()> fire) {
+    // Rounded up, so a timer never fires early
+    uint64_t tick = at_ms > 0 ? (uint64_t)((at_ms + tick_ms - 1e-9) / tick_ms)
+                              : 0;
+    tick = max(tick, current_tick + 1);
+    slots[tick % slots.size()].push_back({tick, move(fire)});
+    pending++;
+}
+
+void TimerWheel::advance() {
+    if (pending == 0)
+        return;
+
+    // Next slot holding a timer due in this turn; when every pending timer
+    // is further out, sleep through the whole turn
+    uint64_t due = current_tick + slots.size();
+    for (uint64_t tick = current_tick + 1; tick < due; tick++) {
+        bool found = false;
+        for (const Timer &timer : slots[tick % slots.size()])
+            found = found || timer.deadline_tick <= tick;
+        if (found) {
+            due = tick;
+            break;
+        }
+    }
+    this_thread::sleep_until(timeOf(due));
+
+    // Fire every tick that has passed, including any we slept through
+    double elapsed_ms =
+        chrono::duration<double, milli>(clock::now() - start).count();
+    uint64_t now_tick = max(due, (uint64_t)(elapsed_ms / tick_ms));
+    for (uint64_t tick = current_tick + 1; tick <= now_tick; tick++) {
+        current_tick = tick;
+        if (pending == 0)
+            continue;
+        vector<Timer> &slot = slots[tick % slots.size()];
+        vector<Timer> later;
+        for (Timer &timer : slot) {
+            if (timer.deadline_tick <= tick) {
+                pending--;
+                timer.fire();
+            } else {
+                later.push_back(move(timer));
+            }
+        }
+        slot.swap(later);
+    }
+}
+
+bool parseOverloadPolicy(const string &name, OverloadPolicy &policy) {
+    if (name == "block")
+        policy = OverloadPolicy::BLOCK;
+    else if (name == "reject")
+        policy = OverloadPolicy::REJECT;
+    else if (name == "shed")
+        policy = OverloadPolicy::SHED_DUPLICATES;
+    else
+        return false;
+    return true;
+}
+
+AdmissionControl::AdmissionControl(size_t capacity, OverloadPolicy policy)
+    : capacity(max<size_t>(capacity, 1)), policy(policy) {}
+
+AdmissionControl::Outcome AdmissionControl::admit(const string &key) {
+    unique_lock<mutex> lock(admission_mutex);
+    if (admitted >= capacity) {
+        if (policy == OverloadPolicy::REJECT)
+            return REJECTED;
+        if (policy == OverloadPolicy::SHED_DUPLICATES &&
+            admitted_keys.count(key))
+            return SHED;
+        released.wait(lock, [this] { return admitted < capacity; });
+    }
+    admitted++;
+    admitted_keys[key]++;
+    return ADMITTED;
+}
+
+void AdmissionControl::release(const string &key) {
+    {
+        lock_guard<mutex> lock(admission_mutex);
+        admitted--;
+        auto it = admitted_keys.find(key);
+        if (it != admitted_keys.end() && --it->second == 0)
+            admitted_keys.erase(it);
+    }
+    released.notify_one();
+}
+
+AdmissionSlot::AdmissionSlot(AdmissionControl &control, const string &key)
+    : place(make_shared<Place>(control, key)) {}
+
+void AdmissionSlot::Place::release() {
+    if (!released.exchange(true))
+        control.release(key);
+}
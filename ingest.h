@@ -0,0 +1,120 @@
+// ingest.h
+#ifndef INGEST_H
+#define INGEST_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/*
+ * Hashed timing wheel that dispatches the arrivals of a request file.
+ *
+ * Time is cut into ticks of `tick_ms`; a timer goes into slot
+ * (deadline tick mod slots) with the number of full turns it still has to
+ * wait, so scheduling and firing are O(1) however many arrivals are
+ * pending. Timers due in the same tick fire together, in the order they
+ * were scheduled.
+ *
+ * The wheel has no thread of its own: the caller schedules timers and calls
+ * advance(), which sleeps until the next non-empty slot (at most one turn
+ * of the wheel) and fires everything due by then. A timer that blocks in
+ * its callback holds back the ones after it.
+ */
+class TimerWheel {
+  private:
+    struct Timer {
+        uint64_t deadline_tick;
+        std::function<void()> fire;
+    };
+
+    typedef std::chrono::steady_clock clock;
+    clock::time_point start;
+    double tick_ms;
+    std::vector<std::vector<Timer>> slots;
+    uint64_t current_tick = 0; // every timer up to this tick has fired
+    size_t pending = 0;
+
+    clock::time_point timeOf(uint64_t tick) const;
+
+  public:
+    TimerWheel(double tick_ms, size_t num_slots);
+
+    // Fire `fire` once `at_ms` have passed since the wheel was made; a time
+    // already past fires on the next advance()
+    void schedule(double at_ms, std::function<void()> fire);
+
+    // Wait for the next due timers and fire them; returns at once when
+    // nothing is pending
+    void advance();
+
+    size_t size() const { return pending; }
+};
+
+/*
+ * What to do with an arrival when `capacity` submissions are already
+ * admitted (queued or being judged):
+ *      BLOCK           - wait for one to finish; later arrivals wait too
+ *      REJECT          - refuse it
+ *      SHED_DUPLICATES - refuse it if an identical submission (same
+ *                        problem and source) is admitted, whose verdict it
+ *                        would only repeat; otherwise wait
+ */
+enum class OverloadPolicy { BLOCK, REJECT, SHED_DUPLICATES };
+
+// Parse "block", "reject" or "shed"; returns false on anything else
+bool parseOverloadPolicy(const std::string &name, OverloadPolicy &policy);
+
+// Bound on the submissions handed to the judge and not finished yet
+class AdmissionControl {
+  private:
+    size_t capacity;
+    OverloadPolicy policy;
+    size_t admitted = 0;
+    std::map<std::string, int> admitted_keys; // key -> how many admitted
+    std::mutex admission_mutex;
+    std::condition_variable released;
+
+  public:
+    enum Outcome { ADMITTED, REJECTED, SHED };
+
+    AdmissionControl(size_t capacity, OverloadPolicy policy);
+
+    // Admit a submission identified by `key`, waiting as the policy says
+    Outcome admit(const std::string &key);
+    // An admitted submission `key` has its verdict
+    void release(const std::string &key);
+};
+
+/*
+ * The place of one admitted submission. release() gives it back; if no one
+ * did by the time the last copy goes away (the judging task threw, or was
+ * dropped), that does, so --overload block cannot wait on it forever.
+ * Copies share the place and it is released once.
+ */
+class AdmissionSlot {
+  private:
+    struct Place {
+        AdmissionControl &control;
+        std::string key;
+        std::atomic<bool> released{false};
+
+        Place(AdmissionControl &control, const std::string &key)
+            : control(control), key(key) {}
+        void release();
+        ~Place() { release(); }
+    };
+    std::shared_ptr<Place> place;
+
+  public:
+    AdmissionSlot(AdmissionControl &control, const std::string &key);
+    void release() const { place->release(); }
+};
+
+#endif // INGEST_H
@@ -0,0 +1,126 @@
+#include "input_store.h"
+
+#include <cerrno>
+
+#include <fcntl.h>
+#include <sys/mman.h>     // for memfd_create
+#include <sys/sendfile.h> // for sendfile
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+// Memory the stored inputs may take in total
+const size_t INPUT_STORE_MAX_BYTES = 512ul << 20; // 512 MB
+
+// Nothing may change a stored input once it is loaded
+const int INPUT_SEALS = F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE |
+                        F_SEAL_SEAL;
+
+string memfdPath(int fd) { return "/proc/self/fd/" + to_string(fd); }
+
+int openMemoryFile(const string &name) {
+    return memfd_create(name.c_str(), MFD_CLOEXEC);
+}
+
+static bool sameFile(const struct stat &st, off_t size, const timespec &mtime) {
+    return st.st_size == size && st.st_mtim.tv_sec == mtime.tv_sec &&
+           st.st_mtim.tv_nsec == mtime.tv_nsec;
+}
+
+// Copy `size` bytes of `path` into a new sealed memfd, -1 on failure
+static int loadSealed(const string &path, off_t size) {
+    int file = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (file < 0)
+        return -1;
+    int fd = memfd_create("oj-input", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    off_t copied = 0;
+    while (fd >= 0 && copied < size) {
+        ssize_t n = sendfile(fd, file, nullptr, (size_t)(size - copied));
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            break;
+        copied += n;
+    }
+    close(file);
+    if (fd >= 0 &&
+        (copied != size || fcntl(fd, F_ADD_SEALS, INPUT_SEALS) < 0)) {
+        close(fd);
+        fd = -1;
+    }
+    return fd;
+}
+
+// A new open file description on `fd`, so the caller's offset is its own
+static int reopen(int fd) {
+    return ::open(memfdPath(fd).c_str(), O_RDONLY | O_CLOEXEC);
+}
+
+InputStore::InputStore(size_t max_bytes) : max_bytes(max_bytes) {}
+
+InputStore::~InputStore() {
+    for (auto &entry : entries)
+        close(entry.second.fd);
+}
+
+// Caller holds store_mutex
+void InputStore::drop(map<string, Entry>::iterator it) {
+    close(it->second.fd);
+    total_bytes -= (size_t)it->second.size;
+    lru.erase(it->second.lru_position);
+    entries.erase(it);
+}
+
+int InputStore::open(const string &path) {
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0)
+        return -1;
+    if (!S_ISREG(st.st_mode) || (size_t)st.st_size > max_bytes)
+        return ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+
+    {
+        lock_guard<mutex> lock(store_mutex);
+        auto it = entries.find(path);
+        if (it != entries.end() &&
+            sameFile(st, it->second.size, it->second.mtime)) {
+            lru.splice(lru.begin(), lru, it->second.lru_position);
+            int fd = reopen(it->second.fd);
+            if (fd >= 0)
+                return fd;
+        }
+    }
+
+    // Load without the lock; two threads loading the same input at once
+    // both copy it and the second one's copy is discarded
+    int sealed = loadSealed(path, st.st_size);
+    if (sealed < 0)
+        return ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+
+    lock_guard<mutex> lock(store_mutex);
+    auto it = entries.find(path);
+    if (it != entries.end()) {
+        if (sameFile(st, it->second.size, it->second.mtime)) {
+            close(sealed);
+            sealed = it->second.fd;
+        } else {
+            drop(it);
+            it = entries.end();
+        }
+    }
+    if (it == entries.end()) {
+        lru.push_front(path);
+        entries[path] = {sealed, st.st_size, st.st_mtim, lru.begin()};
+        total_bytes += (size_t)st.st_size;
+        while (total_bytes > max_bytes && lru.back() != path)
+            drop(entries.find(lru.back()));
+    }
+    int fd = reopen(sealed);
+    // Without /proc the memfd cannot be reopened; read the file instead
+    return fd >= 0 ? fd : ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+}
+
+InputStore &inputStore() {
+    static InputStore store(INPUT_STORE_MAX_BYTES);
+    return store;
+}
@@ -0,0 +1,64 @@
+// input_store.h
+#ifndef INPUT_STORE_H
+#define INPUT_STORE_H
+
+#include <cstddef>
+#include <ctime>
+#include <list>
+#include <map>
+#include <mutex>
+#include <string>
+
+#include <sys/types.h> // for off_t
+
+/*
+ * Test inputs loaded once into sealed memfds.
+ *
+ * Every run gets its own read-only open of the memfd (through
+ * /proc/self/fd), so each has its own file offset while all of them read
+ * the same pages: dozens of concurrent runs on one large input share a
+ * single copy in memory and read nothing from disk. The seals make the
+ * contents immutable, so no run can change what the next one reads.
+ *
+ * An input is reloaded when the file's size or mtime changes. The store is
+ * bounded in bytes and drops the least recently used inputs first; runs
+ * holding one keep their descriptor. Inputs that cannot be stored (too
+ * large, no memfd support) are opened from disk as before.
+ */
+class InputStore {
+  private:
+    struct Entry {
+        int fd;
+        off_t size;
+        timespec mtime;
+        std::list<std::string>::iterator lru_position;
+    };
+
+    size_t max_bytes;
+    size_t total_bytes = 0;
+    std::list<std::string> lru; // most recently used first
+    std::map<std::string, Entry> entries;
+    std::mutex store_mutex;
+
+    void drop(std::map<std::string, Entry>::iterator it);
+
+  public:
+    explicit InputStore(size_t max_bytes);
+    ~InputStore();
+    InputStore(const InputStore &) = delete;
+    InputStore &operator=(const InputStore &) = delete;
+
+    // A read-only descriptor on the contents of `path`, at offset 0 and
+    // owned by the caller; -1 if the file cannot be read
+    int open(const std::string &path);
+};
+
+// The store shared by all judge threads
+InputStore &inputStore();
+
+// An anonymous in-memory file for a run's output (memfd), -1 if memfds are
+// not available. memfdPath() names it for code that opens files by path.
+int openMemoryFile(const std::string &name);
+std::string memfdPath(int fd);
+
+#endif // INPUT_STORE_H
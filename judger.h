@@ -5,10 +5,27 @@
 #include <string>
 
 extern std::string PARTICIPANT_CODE; // = "Submit/probA_AC.cpp";
-extern std::string INPUT_DIR;        // "problem/probA/testcases/";
-extern std::string OUTPUT_DIR;       // "problem/probA/expected_outputs/";
+extern std::string COMPILE_FLAGS;    // g++ flags for participant code
+extern int PARALLEL_TESTS; // test cases of one submission run at once
+extern bool STREAM_OUTPUT;  // compare stdout through a pipe as it arrives
+extern long OUTPUT_LIMIT_BYTES; // largest output of one test, 0 = no limit
+extern long MEMORY_LIMIT_MB; // for problems without their own, 0 = no limit
+extern std::string SCRATCH_DIR; // executables and outputs go here, "" = cwd
+extern bool FORK_SERVER; // run tests as forks of one pre-initialized process
+extern bool REUSE_VERDICTS; // take unchanged tests from the verdict cache
+extern bool FAIL_FAST_ORDER; // run likely failures first (see test_stats.h)
+extern bool ISOLATE_CHECKERS; // special-judge checkers out of process only
 
-void judge(int task_id, std::string dir_code, std::string INPUT_DIR,
-           std::string OUTPUT_DIR);
+// The two stages of judge(), for callers that schedule them separately:
+// compile the submission (false on a compile error), then run the tests of
+// `problem_name` from the problem registry, log the verdict and clean up.
+// A compile error is logged as CE by compileSubmission. A submission whose
+// binary is already being judged on the same problem waits for and reuses
+// that verdict.
+bool compileSubmission(int task_id, std::string dir_code,
+                       std::string problem_name);
+void runSubmission(int task_id, std::string problem_name);
+
+void judge(int task_id, std::string dir_code, std::string problem_name);
 
 #endif // JUDGER_H
\ No newline at end of file
@@ -0,0 +1,105 @@
+#include "load_report.h"
+#include "stats.h"
+
+#include <iomanip> // for setw, setprecision
+#include <ostream>
+
+using namespace std;
+
+// Percentiles shown for every latency series
+const double REPORT_PERCENTILES[] = {50, 90, 99, 100};
+
+static double millisBetween(SubmissionTimes::clock::time_point from,
+                            SubmissionTimes::clock::time_point to) {
+    return chrono::duration<double, milli>(to - from).count();
+}
+
+LoadReport::LoadReport(const vector<SubmissionTimes> &times, double wall_ms,
+                       const vector<bool> &dropped)
+    : wall_ms(wall_ms) {
+    for (size_t i = 0; i < times.size(); i++) {
+        if (i < dropped.size() && dropped[i]) {
+            rejected++;
+            continue;
+        }
+        const SubmissionTimes &t = times[i];
+        submissions++;
+        double wait = millisBetween(t.submitted, t.compile_start);
+        compile_ms.push_back(millisBetween(t.compile_start, t.compile_end));
+        if (t.compiled) {
+            wait += millisBetween(t.compile_end, t.run_start);
+            run_ms.push_back(millisBetween(t.run_start, t.done));
+        } else {
+            compile_errors++;
+        }
+        queue_wait_ms.push_back(wait);
+        latency_ms.push_back(millisBetween(t.submitted, t.done));
+    }
+}
+
+void LoadReport::addUtilization(const string &name, double fraction) {
+    utilization.push_back({name, fraction});
+}
+
+void LoadReport::printTable(ostream &out) const {
+    out << fixed << setprecision(1);
+    out << "Submissions: " << submissions << " (" << compile_errors
+        << " compile errors, " << rejected << " rejected) in " << wall_ms
+        << " ms, throughput "
+        << (wall_ms > 0 ? submissions * 1000.0 / wall_ms : 0.0)
+        << " submissions/s\n";
+
+    out << left << setw(12) << "ms" << right;
+    for (double p : REPORT_PERCENTILES)
+        out << setw(10) << (p == 100 ? string("max") : "p" + to_string((int)p));
+    out << '\n';
+    auto row = [&](const string &name, const vector<double> &samples) {
+        out << left << setw(12) << name << right;
+        for (double p : REPORT_PERCENTILES)
+            out << setw(10) << percentile(samples, p);
+        out << '\n';
+    };
+    row("queue wait", queue_wait_ms);
+    row("compile", compile_ms);
+    row("run", run_ms);
+    row("latency", latency_ms);
+
+    for (const auto &pool : utilization)
+        out << "Utilization " << pool.first << ": " << 100 * pool.second
+            << "%\n";
+    out << defaultfloat;
+}
+
+void LoadReport::writeJson(ostream &out) const {
+    auto series = [&](const string &name, const vector<double> &samples) {
+        out << "  \"" << name << "_ms\": {";
+        bool first = true;
+        for (double p : REPORT_PERCENTILES) {
+            out << (first ? "" : ", ") << '"'
+                << (p == 100 ? string("max") : "p" + to_string((int)p))
+                << "\": " << percentile(samples, p);
+            first = false;
+        }
+        out << "},\n";
+    };
+
+    out << setprecision(6);
+    out << "{\n";
+    out << "  \"submissions\": " << submissions << ",\n";
+    out << "  \"compile_errors\": " << compile_errors << ",\n";
+    out << "  \"rejected\": " << rejected << ",\n";
+    out << "  \"wall_ms\": " << wall_ms << ",\n";
+    out << "  \"throughput_per_s\": "
+        << (wall_ms > 0 ? submissions * 1000.0 / wall_ms : 0.0) << ",\n";
+    series("queue_wait", queue_wait_ms);
+    series("compile", compile_ms);
+    series("run", run_ms);
+    series("latency", latency_ms);
+    out << "  \"utilization\": {";
+    for (size_t i = 0; i < utilization.size(); i++)
+        out << (i ? ", " : "") << '"' << utilization[i].first
+            << "\": " << utilization[i].second;
+    out << "}\n";
+    out << "}\n";
+    out << defaultfloat;
+}
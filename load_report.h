@@ -0,0 +1,57 @@
+// load_report.h
+#ifndef LOAD_REPORT_H
+#define LOAD_REPORT_H
+
+#include <chrono>
+#include <iosfwd>
+#include <string>
+#include <utility>
+#include <vector>
+
+/*
+ * When one submission went through the judge:
+ *      submitted     - handed to the pool or pipeline
+ *      compile_start - a worker started compiling it
+ *      compile_end   - compile finished (or failed)
+ *      run_start     - a worker started running its tests
+ *      done          - verdict printed
+ * A submission that failed to compile has compiled == false and no run.
+ */
+struct SubmissionTimes {
+    typedef std::chrono::steady_clock clock;
+    clock::time_point submitted, compile_start, compile_end, run_start, done;
+    bool compiled = false;
+};
+
+/*
+ * End-to-end numbers of one OJ run, for sizing the pools:
+ *      throughput     - submissions judged per second of wall time
+ *      queue wait     - time queued before compiling plus, in the pipeline,
+ *                       time queued between compile and run
+ *      compile, run   - time spent in each stage
+ *      latency        - submission to verdict
+ *      utilization    - busy fraction of each pool's workers
+ * Submissions turned away by admission control (`dropped`) were never
+ * judged: they are only counted as rejected, not in any of the above.
+ */
+class LoadReport {
+  private:
+    size_t submissions = 0;
+    size_t compile_errors = 0;
+    size_t rejected = 0;
+    double wall_ms = 0;
+    std::vector<double> queue_wait_ms, compile_ms, run_ms, latency_ms;
+    std::vector<std::pair<std::string, double>> utilization;
+
+  public:
+    LoadReport(const std::vector<SubmissionTimes> &times, double wall_ms,
+               const std::vector<bool> &dropped = {});
+
+    // Busy fraction (0..1) of the workers of pool `name`
+    void addUtilization(const std::string &name, double fraction);
+
+    void printTable(std::ostream &out) const;
+    void writeJson(std::ostream &out) const;
+};
+
+#endif // LOAD_REPORT_H
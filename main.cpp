@@ -1,21 +1,62 @@
 #include "judger.h"
-
-#include <chrono>             // for time measurement
-#include <condition_variable> // for condition_variable
-#include <fstream>            // for read request file
-#include <functional>         // for std::ref
-#include <iostream>           // for std::cout, std::cerr
-#include <mutex>              // for std::mutex
-#include <queue>              // for std::queue
-#include <string>             // for std::string
-#include <thread>             // for multithreading
-#include <vector>             // for std::vector
+#include "compile_server.h"
+#include "coordinator.h"
+#include "daemon.h"
+#include "ingest.h"
+#include "load_report.h"
+#include "metrics.h"
+#include "pipeline.h"
+#include "problems.h"
+#include "result_log.h"
+#include "runner.h"
+#include "simulator.h"
+#include "special_checker.h"
+#include "stats.h"
+#include "test_stats.h"
+#include "thread_pool.h"
+#include "trace.h"
+#include "verdict_cache.h"
+#include "worker.h"
+
+#include <algorithm>  // for std::max
+#include <chrono>     // for time measurement
+#include <filesystem> // for the coordinator socket's directory
+#include <fstream>    // for read request file
+#include <future>     // for std::future
+#include <functional> // for std::ref
+#include <iostream>   // for std::cout, std::cerr
+#include <memory>     // for unique_ptr
+#include <set>        // for the simulated pool sizes
+#include <sstream>    // for splitting option lists
+#include <string>     // for std::string
+#include <thread>     // for multithreading
+#include <vector>     // for std::vector
 
 using namespace std;
+namespace fs = std::filesystem;
 
 std::string PARTICIPANT_CODE = "Submit/probA_AC.cpp";
-std::string INPUT_DIR = "problem/probA/testcases/";
-std::string OUTPUT_DIR = "problem/probA/expected_outputs/";
+std::string COMPILE_FLAGS = "";
+std::string SCRATCH_DIR = "";
+int PARALLEL_TESTS = 1;
+bool STREAM_OUTPUT = false;
+bool FORK_SERVER = false;
+bool REUSE_VERDICTS = false;
+bool FAIL_FAST_ORDER = false;
+bool ISOLATE_CHECKERS = false;
+long OUTPUT_LIMIT_BYTES = 256L << 20;
+long MEMORY_LIMIT_MB = 256;
+
+// Arrival dispatch: 1 ms ticks on a wheel of about one second, with at most
+// this many arrivals read ahead of time
+const double INGEST_TICK_MS = 1;
+const size_t INGEST_WHEEL_SLOTS = 1024;
+const size_t INGEST_LOOKAHEAD = 4096;
+
+// Historical job durations for the SJF policy, kept between runs
+const string JOB_COSTS_FILE = ".oj_cache/job_costs.txt";
+// Per-test failure rates and run times, for --order failfast
+const string TEST_STATS_FILE = ".oj_cache/test_stats.txt";
 
 // The print function represents a task that takes a string reference as input
 // and prints it.
@@ -26,197 +67,605 @@ void print(string &s) {
     this_thread::sleep_for(chrono::milliseconds(100));
 }
 
-class ThreadPool {
-  private:
-    // A list of threads in the pool
-    vector<thread> threads;
-    vector<bool> idle_thread;
-
-    // A queue of tasks
-    queue<function<void()>> tasks;
-
-    // Mutex and condition variable for synchronization
-    mutex queue_mutex;
-    condition_variable condition;
-
-    // A flag to stop the pool
-    bool stop;
-
-  public:
-    /*
-    Constructor:
-    - init stop flag to False, meaning the pool is running
-    - create a number of threads and add them to the pool, each thread
-    have a while loop, that will keep the thread running until the pool
-    is stopped. The thread will wait for a task to be added to the queue
-    and then execute the task.
-    */
-    ThreadPool(int num_threads) : stop(false) {
-        // set up idle_thread
-        for (int i = 0; i < num_threads; ++i)
-            idle_thread.push_back(true);
-
-        // For each thread, create a lambda function that will keep the
-        // thread running
-        for (int i = 0; i < num_threads; i++) {
-            // Create a thread, add to the list of threads
-            threads.emplace_back([this, i] {
-                while (true) {
-                    // Create a task variable, which has no task initially
-                    function<void()> task;
-
-                    {
-                        // Lock the mutex in this scope, to protect the tasks
-                        // queue
-                        unique_lock<mutex> lock(this->queue_mutex);
-
-                        // Wait for a task to be added to the queue, or the pool
-                        // to be stopped
-                        this->condition.wait(lock, [this] {
-                            return this->stop || !this->tasks.empty();
-                        });
-
-                        // If the pool is stopped and the queue is empty, then
-                        // return
-                        if (this->stop && this->tasks.empty())
-                            return;
-
-                        // Get the nearest task from the queue
-                        task = move(this->tasks.front());
-
-                        // thread gets task => idle = false
-                        this->idle_thread[i] = false;
-
-                        // Remove the task from the queue
-                        this->tasks.pop();
-                    }
-
-                    // Execute the task
-                    task();
-
-                    // finish task => idle = true
-                    this->idle_thread[i] = true;
-                }
-            });
+// Judge again every submission ever judged against `problem`, taking the
+// tests whose key did not change from the verdict cache
+static int rejudge(const string &problem, int threads) {
+    vector<string> sources = verdictCache().submissionsOf(problem);
+    if (sources.empty()) {
+        cerr << "No submissions of " << problem << " to rejudge\n";
+        return 1;
+    }
+    auto start = chrono::steady_clock::now();
+    {
+        ThreadPool pool(threads);
+        for (size_t i = 0; i < sources.size(); i++) {
+            cout << "Rejudging task " << i << ": " << sources[i] << endl;
+            TaskInfo info = {problem, problem + ":" + sources[i]};
+            string source = sources[i];
+            pool.add_task([=] { judge((int)i, source, problem); }, info);
         }
+        pool.wait_idle();
     }
+    resultLog().close();
+    testStats().save(TEST_STATS_FILE);
+
+    long elapsed_ms = chrono::duration_cast<chrono::milliseconds>(
+                          chrono::steady_clock::now() - start)
+                          .count();
+    MetricsSnapshot metrics = snapshotMetrics();
+    cout << "Rejudged " << sources.size() << " submissions of " << problem
+         << " in " << elapsed_ms << " ms: "
+         << metrics.counters[(int)Counter::TESTS_REUSED] << " tests reused, "
+         << metrics.counters[(int)Counter::TESTS_RUN] << " run\n";
+    return 0;
+}
 
-    /*
-     * add_task function: add a task (function) to the task queue
-     */
-    void add_task(function<void()> task) {
-        {
-            // Lock the mutex to protect the tasks queue
-            unique_lock<mutex> lock(queue_mutex);
+// Replay `request` in virtual time for every pool size and policy and print
+// the predicted makespan, utilization and latencies
+static int simulate(const string &request, const SimModel &model,
+                    set<int> pool_sizes,
+                    const vector<SchedulePolicy> &policies) {
+    vector<SimJob> jobs;
+    int num_threads = 0;
+    if (!readRequestFile("Test/" + request + ".txt", jobs, num_threads)) {
+        cerr << "Cannot read request " << request << '\n';
+        return 1;
+    }
+    if (pool_sizes.empty())
+        pool_sizes = {1, 2, 4, 8, max(1, num_threads)};
+
+    problemRegistry().loadAll();
+    CostModel costs;
+    costs.load(JOB_COSTS_FILE);
+    testStats().load(TEST_STATS_FILE);
+    Simulator simulator(jobs, model, costs, testStats());
+    cout << "Simulating " << jobs.size() << " submissions ("
+         << simulator.recordedJobs() << " from recorded profiles)\n";
+
+    vector<SimResult> results;
+    for (int threads : pool_sizes)
+        for (SchedulePolicy policy : policies)
+            results.push_back(simulator.run(threads, policy));
+    printSimTable(cout, results);
+    return 0;
+}
 
-            // If the pool is stopped, throw an exception
-            if (stop)
-                throw runtime_error("ThreadPool is stopped");
+int main(int argc, char *argv[]) {
+    // Usage: ./OJ <request> [options], ./OJ --daemon <spool> [options],
+    // ./OJ --worker <coordinator socket> [options] or
+    // ./OJ --rejudge <problem> [options]
+    // Started by the judge itself for checker_mode process (see
+    // special_checker.h), not by hand
+    if (argc == 4 && string(argv[1]) == "--checker-host")
+        return runCheckerHost(argv[2], stoi(argv[3]));
+
+    bool daemon_mode = argc >= 2 && string(argv[1]) == "--daemon";
+    bool worker_mode = argc >= 2 && string(argv[1]) == "--worker";
+    bool rejudge_mode = argc >= 2 && string(argv[1]) == "--rejudge";
+    bool named_mode = daemon_mode || worker_mode || rejudge_mode;
+    if (argc < 2 || (named_mode && argc < 3)) {
+        cerr << "Usage: " << argv[0] << " <request>.txt [options]\n"
+             << "       " << argv[0] << " --daemon <spool dir> [options]\n"
+             << "       " << argv[0] << " --worker <coordinator socket> "
+                "[options]\n"
+             << "       " << argv[0] << " --rejudge <problem> [options]\n"
+             << "  --socket <path>             (daemon) also take "
+                "submissions on this Unix socket\n"
+             << "  --threads <n>               judge threads of the daemon, "
+                "of each worker process or of a rejudge\n"
+             << "  --workers <n>               judge in n worker processes "
+                "behind a coordinator\n"
+             << "  --coordinator-socket <path> where workers reach the "
+                "coordinator\n"
+             << "  --compile-server <workers>  compile on warm workers\n"
+             << "  --parallel-tests <n>        run n tests of a submission "
+                "at once (0 = one per core)\n"
+             << "  --pipeline <workers>        compile on a separate pool of "
+                "<workers> feeding the run pool\n"
+             << "  --queue-depth <n>           compiled submissions allowed "
+                "to wait for the run pool\n"
+             << "  --policy fifo|sjf|fair      order of queued submissions\n"
+             << "  --max-queued <n>            submissions admitted and not "
+                "judged yet (default 1000)\n"
+             << "  --overload block|reject|shed  when --max-queued is reached:"
+                " wait, refuse, or drop duplicates\n"
+             << "  --time-scale <f>            multiply the request's arrival "
+                "times by f (0.1 = 10x faster)\n"
+             << "  --pin                       pin every run worker to its own "
+                "core (always on with --pipeline)\n"
+             << "  --compile-cores <n>         cores kept for compiles, the "
+                "rest run tests\n"
+             << "  --stream                    compare output through a pipe, "
+                "stop at the first wrong byte\n"
+             << "  --fork-server               start a submission once and "
+                "fork it for every test\n"
+             << "  --isolate-checkers          run every problem's own "
+                "checker in a separate process\n"
+             << "  --order natural|failfast    order of the tests; failfast "
+                "runs likely failures first\n"
+             << "  --output-limit <MB>         largest output of one test "
+                "(0 = no limit)\n"
+             << "  --memory-limit <MB>         memory of one test, unless the "
+                "problem sets its own (0 = no limit)\n"
+             << "  --cgroup <dir>              enforce memory limits in "
+                "cgroup v2 leaves under <dir>\n"
+             << "  --simulate                  predict the request's "
+                "makespan and latencies instead of judging\n"
+             << "  --sim-threads <n,n,...>     pool sizes to simulate "
+                "(default 1,2,4,8 and the request's)\n"
+             << "  --sim-policies <p,p,...>    policies to simulate (default "
+                "fifo,sjf,fair)\n"
+             << "  --sim-model recorded|distribution  durations from past "
+                "runs where known, or all sampled\n"
+             << "  --sim-compile-ms <ms>       mean sampled compile time\n"
+             << "  --sim-test-ms <ms>          mean sampled time of one test\n"
+             << "  --sim-seed <n>              seed of the sampled durations\n"
+             << "  --bench <out.json>          print a throughput/latency "
+                "table and write it as JSON\n"
+             << "  --metrics <file>            keep phase timings and "
+                "counters in <file> (.json or Prometheus text)\n"
+             << "  --metrics-interval <ms>     how often --metrics is "
+                "rewritten (default 1000)\n"
+             << "  --trace <out.json>          write a timeline of every "
+                "submission for chrome://tracing\n"
+             << "  --results <out.jsonl>       also log every verdict as one "
+                "JSON object per line\n";
+        return 1;
+    }
 
-            // Add the task to the queue
-            tasks.push(move(task));
+    int compile_servers = 0;
+    int pipeline_compilers = 0;
+    int queue_depth = 0;
+    bool pin = false;
+    int compile_cores = 0;
+    string bench_json;
+    string metrics_file;
+    int metrics_interval_ms = 1000;
+    string trace_file;
+    string results_file;
+    string socket_path;
+    int judge_threads = 0;
+    int worker_processes = 0;
+    string coordinator_socket = ".oj_work/coordinator.sock";
+    string cgroup_dir;
+    SchedulePolicy policy = SchedulePolicy::FIFO;
+    size_t max_queued = 1000;
+    OverloadPolicy overload = OverloadPolicy::BLOCK;
+    double time_scale = 1;
+    bool simulate_mode = false;
+    SimModel sim_model;
+    set<int> sim_threads;
+    vector<SchedulePolicy> sim_policies = {
+        SchedulePolicy::FIFO, SchedulePolicy::SJF, SchedulePolicy::FAIR};
+    for (int i = named_mode ? 3 : 2; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--compile-server" && i + 1 < argc) {
+            compile_servers = stoi(argv[++i]);
+        } else if (arg == "--parallel-tests" && i + 1 < argc) {
+            PARALLEL_TESTS = stoi(argv[++i]);
+            if (PARALLEL_TESTS <= 0)
+                PARALLEL_TESTS = max(1u, thread::hardware_concurrency());
+        } else if (arg == "--pipeline" && i + 1 < argc) {
+            pipeline_compilers = stoi(argv[++i]);
+        } else if (arg == "--queue-depth" && i + 1 < argc) {
+            queue_depth = stoi(argv[++i]);
+        } else if (arg == "--stream") {
+            STREAM_OUTPUT = true;
+        } else if (arg == "--fork-server") {
+            FORK_SERVER = true;
+        } else if (arg == "--isolate-checkers") {
+            ISOLATE_CHECKERS = true;
+        } else if ((arg == "--order" && i + 1 < argc) ||
+                   arg.compare(0, 8, "--order=") == 0) {
+            string order = arg == "--order" ? argv[++i] : arg.substr(8);
+            if (order != "natural" && order != "failfast") {
+                cerr << "Unknown test order " << order << '\n';
+                return 1;
+            }
+            FAIL_FAST_ORDER = order == "failfast";
+        } else if (arg == "--output-limit" && i + 1 < argc) {
+            OUTPUT_LIMIT_BYTES = stol(argv[++i]) << 20;
+        } else if (arg == "--pin") {
+            pin = true;
+        } else if (arg == "--compile-cores" && i + 1 < argc) {
+            compile_cores = stoi(argv[++i]);
+        } else if (arg == "--bench" && i + 1 < argc) {
+            bench_json = argv[++i];
+        } else if (arg == "--metrics" && i + 1 < argc) {
+            metrics_file = argv[++i];
+        } else if (arg == "--metrics-interval" && i + 1 < argc) {
+            metrics_interval_ms = max(1, stoi(argv[++i]));
+        } else if (arg == "--socket" && i + 1 < argc) {
+            socket_path = argv[++i];
+        } else if (arg == "--threads" && i + 1 < argc) {
+            judge_threads = stoi(argv[++i]);
+        } else if (arg == "--workers" && i + 1 < argc) {
+            worker_processes = stoi(argv[++i]);
+        } else if (arg == "--coordinator-socket" && i + 1 < argc) {
+            coordinator_socket = argv[++i];
+        } else if (arg == "--results" && i + 1 < argc) {
+            results_file = argv[++i];
+        } else if (arg == "--trace" && i + 1 < argc) {
+            trace_file = argv[++i];
+        } else if (arg == "--memory-limit" && i + 1 < argc) {
+            MEMORY_LIMIT_MB = stol(argv[++i]);
+        } else if (arg == "--cgroup" && i + 1 < argc) {
+            cgroup_dir = argv[++i];
+            if (!useCgroup(cgroup_dir))
+                cerr << "cgroup v2 memory controller not available in "
+                     << cgroup_dir << ", using rlimits\n";
+        } else if (arg == "--max-queued" && i + 1 < argc) {
+            max_queued = (size_t)max(1, stoi(argv[++i]));
+        } else if (arg == "--overload" && i + 1 < argc &&
+                   parseOverloadPolicy(argv[i + 1], overload)) {
+            i++;
+        } else if (arg == "--time-scale" && i + 1 < argc) {
+            time_scale = max(0.0, stod(argv[++i]));
+        } else if (arg == "--simulate") {
+            simulate_mode = true;
+        } else if (arg == "--sim-threads" && i + 1 < argc) {
+            istringstream list(argv[++i]);
+            string size;
+            while (getline(list, size, ','))
+                sim_threads.insert(max(1, stoi(size)));
+        } else if (arg == "--sim-policies" && i + 1 < argc) {
+            istringstream list(argv[++i]);
+            string name;
+            sim_policies.clear();
+            while (getline(list, name, ',')) {
+                SchedulePolicy p;
+                if (!parsePolicy(name, p)) {
+                    cerr << "Unknown policy " << name << '\n';
+                    return 1;
+                }
+                sim_policies.push_back(p);
+            }
+        } else if (arg == "--sim-model" && i + 1 < argc) {
+            string model = argv[++i];
+            if (model != "recorded" && model != "distribution") {
+                cerr << "Unknown simulation model " << model << '\n';
+                return 1;
+            }
+            sim_model.recorded = model == "recorded";
+        } else if (arg == "--sim-compile-ms" && i + 1 < argc) {
+            sim_model.compile_ms = stod(argv[++i]);
+        } else if (arg == "--sim-test-ms" && i + 1 < argc) {
+            sim_model.test_ms = stod(argv[++i]);
+        } else if (arg == "--sim-seed" && i + 1 < argc) {
+            sim_model.seed = (unsigned)stoul(argv[++i]);
+        } else if (arg == "--policy" && i + 1 < argc &&
+                   parsePolicy(argv[i + 1], policy)) {
+            i++;
+        } else {
+            cerr << "Unknown option " << arg << '\n';
+            return 1;
         }
+    }
+
+    if (simulate_mode && !named_mode)
+        return simulate(argv[1], sim_model, sim_threads, sim_policies);
 
-        // Notify one of the threads to execute the task
-        condition.notify_one();
+    if (worker_mode) {
+        precompiledHeaderArgs(COMPILE_FLAGS);
+        problemRegistry().loadAll();
+        testStats().load(TEST_STATS_FILE);
+        int status = runWorker(argv[2], max(1, judge_threads));
+        testStats().save(TEST_STATS_FILE);
+        return status;
     }
 
-    // check if finishing all task
-    bool finish_all_tasks() {
-        for (bool idle_i : idle_thread) {
-            if (idle_i == false)
-                return false;
-        }
-        if (tasks.empty())
-            return true;
-        return false;
+    if (rejudge_mode) {
+        REUSE_VERDICTS = true;
+        precompiledHeaderArgs(COMPILE_FLAGS);
+        problemRegistry().loadAll();
+        testStats().load(TEST_STATS_FILE);
+        if (!results_file.empty() && !resultLog().openJsonl(results_file))
+            cerr << "Cannot write results to " << results_file << '\n';
+        return rejudge(argv[2],
+                       judge_threads > 0
+                           ? judge_threads
+                           : max(1u, thread::hardware_concurrency()));
     }
 
-    /*
-    Destructor: wait for all threads to finish executing their tasks
-    then join the threads and exit the program
-    */
-    ~ThreadPool() {
-        {
-            // Lock the mutex to protect the tasks queue
-            unique_lock<mutex> lock(queue_mutex);
-
-            // Set the stop flag to true, meaning the pool is stopped
-            stop = true;
-        }
+    ifstream request_file;
+    int num_threads = 0, num_tasks = 0;
+    if (daemon_mode) {
+        // Before any thread exists, so that none of them takes the signals
+        JudgeDaemon::blockStopSignals();
+        num_threads = judge_threads > 0
+                          ? judge_threads
+                          : max(1u, thread::hardware_concurrency());
+    } else {
+        request_file.open("Test/" + string(argv[1]) + ".txt", ios::in);
+        request_file >> num_tasks >> num_threads;
+    }
 
-        // Notify all threads to stop
-        condition.notify_all();
+    // Cores for compiles and for timed runs
+    vector<int> compile_cpus, run_cpus;
+    if (pin || pipeline_compilers > 0)
+        splitCpus(num_threads, compile_cores, compile_cpus, run_cpus);
 
-        // Join all threads
-        for (thread &t : threads) {
-            t.join();
-        }
-    }
-};
+    // Precompile <bits/stdc++.h> before the first submission arrives
+    if (compile_servers > 0)
+        startCompileServer(compile_servers, COMPILE_FLAGS, compile_cpus);
+    else
+        precompiledHeaderArgs(COMPILE_FLAGS);
+
+    // Index the problems once; submissions look their tests up in memory
+    size_t num_problems = problemRegistry().loadAll();
+    cout << "Loaded " << num_problems << " problems" << endl;
+
+    CostModel costs;
+    costs.load(JOB_COSTS_FILE);
+    testStats().load(TEST_STATS_FILE);
+
+    // Export phase timings and counters while the judge runs
+    unique_ptr<MetricsExporter> metrics;
+    if (!metrics_file.empty())
+        metrics.reset(new MetricsExporter(metrics_file, metrics_interval_ms));
+
+    if (!trace_file.empty())
+        startTrace();
+    if (!results_file.empty() && !resultLog().openJsonl(results_file))
+        cerr << "Cannot write results to " << results_file << '\n';
+
+    // Stage timestamps of every task, each written only by its own task
+    vector<SubmissionTimes> times(num_tasks);
+    vector<string> problems(num_tasks), sources(num_tasks);
+
+    // One future per submission by task id, ready once it has been judged
+    vector<future<void>> judged(num_tasks);
 
-int main(int argc, char *argv[]) {
     // get start time
     auto start_time = std::chrono::high_resolution_clock::now();
 
-    // Usage: ./main <numOfString> <NumOfThreads>
-    if (argc != 2) {
-        cerr << "Usage: " << argv[0] << " <request>.txt\n";
-        return 1;
+    //  Create a thread pool with num_threads threads, or a compile pool
+    //  feeding a run pool of num_threads threads, or hand submissions to
+    //  worker processes
+    unique_ptr<ThreadPool> pool;
+    unique_ptr<JudgePipeline> pipeline;
+    unique_ptr<Coordinator> coordinator;
+    if (worker_processes > 0) {
+        fs::create_directories(fs::path(coordinator_socket).parent_path());
+        coordinator.reset(new Coordinator(coordinator_socket));
+        if (!coordinator->start())
+            return 1;
+        // Workers get the judge options; the scheduling ones stay here
+        vector<string> judge_args = {
+            "--parallel-tests", to_string(PARALLEL_TESTS),
+            "--output-limit",   to_string(OUTPUT_LIMIT_BYTES >> 20),
+            "--memory-limit",   to_string(MEMORY_LIMIT_MB)};
+        if (STREAM_OUTPUT)
+            judge_args.push_back("--stream");
+        if (FORK_SERVER)
+            judge_args.push_back("--fork-server");
+        if (FAIL_FAST_ORDER)
+            judge_args.insert(judge_args.end(), {"--order", "failfast"});
+        if (ISOLATE_CHECKERS)
+            judge_args.push_back("--isolate-checkers");
+        if (!cgroup_dir.empty())
+            judge_args.insert(judge_args.end(), {"--cgroup", cgroup_dir});
+        coordinator->spawnLocalWorkers(worker_processes,
+                                       max(1, judge_threads), judge_args);
+    } else if (pipeline_compilers > 0) {
+        if (queue_depth <= 0)
+            queue_depth = 2 * num_threads;
+        pipeline.reset(new JudgePipeline(pipeline_compilers, num_threads,
+                                         queue_depth, compile_cpus, run_cpus,
+                                         policy, &costs));
+    } else {
+        pool.reset(new ThreadPool(num_threads, run_cpus, policy, &costs, pin));
     }
 
-    ifstream request_file;
-    request_file.open("Test/" + string(argv[1]) + ".txt", ios::in);
-    int num_threads, num_tasks;
-    request_file >> num_tasks >> num_threads;
+    if (daemon_mode) {
+        JudgeDaemon daemon(
+            argv[2], socket_path,
+            [&](int task_id, const string &source, const string &problem) {
+                TaskInfo info = {problem, problem + ":" + source};
+                if (coordinator)
+                    coordinator->submit(task_id, source, problem);
+                else if (pipeline)
+                    pipeline->submit(task_id, source, problem, info);
+                else
+                    pool->add_task(
+                        [=] { judge(task_id, source, problem); }, info);
+            });
+        bool ok = daemon.run();
+        // Judge what was taken in, then deliver it before `daemon` goes
+        if (coordinator)
+            coordinator->wait_idle();
+        else if (pipeline)
+            pipeline->wait_idle();
+        else
+            pool->wait_idle();
+        resultLog().close();
+        metrics.reset();
+        if (!trace_file.empty() && !writeTrace(trace_file))
+            cerr << "Cannot write trace to " << trace_file << '\n';
+        costs.save(JOB_COSTS_FILE);
+        testStats().save(TEST_STATS_FILE);
+        return ok ? 0 : 1;
+    }
 
-    //  Create a thread pool with num_threads threads
-    ThreadPool pool(num_threads);
-    for (int i = 0; i < num_tasks; i++) {
-        // sleep until new submit
-        int time_arrive;
-        request_file >> time_arrive;
-        auto current_time = std::chrono::high_resolution_clock::now();
-        int time_to_next_submit =
-            time_arrive - chrono::duration_cast<chrono::milliseconds>(
-                              current_time - start_time)
-                              .count();
-        if (time_to_next_submit > 0)
-            this_thread::sleep_for(chrono::milliseconds(time_to_next_submit));
-
-        // problem of submit
-        string problem;
-        request_file >> problem;
-        problem = "../problem/" + problem;
-
-        INPUT_DIR = "problem/" + problem + "/testcases/";
-        OUTPUT_DIR = "problem/" + problem + "/expected_outputs/";
-
-        // code directory of submit
-        string dir_code;
-        request_file >> dir_code;
-        PARTICIPANT_CODE = "Submit/" + dir_code + ".cpp";
-        dir_code = "Submit/" + dir_code + ".cpp";
-
-        cout << "Adding task " << problem << " for code " << dir_code
-             << " to the pool at time " << time_arrive << endl;
-
-        string exit_code, message;
-        pool.add_task(bind(judge, i, dir_code, INPUT_DIR, OUTPUT_DIR));
+    // Submissions handed to the judge and not finished yet, and those that
+    // never were
+    AdmissionControl admission(max_queued, overload);
+    vector<bool> dropped(num_tasks);
+
+    auto dispatch = [&](int i, int time_arrive, const string &problem_name,
+                        const string &dir_code) {
+        PARTICIPANT_CODE = dir_code;
+        cout << "Adding task ../problem/" << problem_name << " for code "
+             << dir_code << " to the pool at time " << time_arrive << endl;
+
+        SubmissionTimes *task_times = &times[i];
+        task_times->submitted = SubmissionTimes::clock::now();
+        problems[i] = problem_name;
+        sources[i] = dir_code;
+
+        // Wait here for room, or turn it away, as --overload says
+        string key = problem_name + ":" + dir_code;
+        AdmissionControl::Outcome outcome = admission.admit(key);
+        if (outcome != AdmissionControl::ADMITTED) {
+            countEvent(outcome == AdmissionControl::SHED
+                           ? Counter::SUBMISSIONS_SHED
+                           : Counter::SUBMISSIONS_REJECTED);
+            ResultRecord record;
+            record.task_id = i;
+            record.problem = problem_name;
+            record.verdict = "RJ";
+            resultLog().log(move(record));
+            task_times->compile_start = task_times->compile_end =
+                task_times->run_start = task_times->done =
+                    task_times->submitted;
+            dropped[i] = true;
+            return;
+        }
+        // Released when judged, or when the task is destroyed unfinished
+        AdmissionSlot slot(admission, key);
+        auto release = [slot] { slot.release(); };
+
+        // SJF looks up this submission's history, then the problem's
+        TaskInfo info = {problem_name, key};
+        if (coordinator)
+            judged[i] = coordinator->submit(i, dir_code, problem_name,
+                                            task_times, release);
+        else if (pipeline)
+            judged[i] = pipeline->submit(i, dir_code, problem_name, info,
+                                         release, task_times);
+        else
+            // judge() with the two stages timed separately
+            judged[i] = pool->add_task(
+                [=] {
+                    task_times->compile_start = SubmissionTimes::clock::now();
+                    task_times->compiled =
+                        compileSubmission(i, dir_code, problem_name);
+                    task_times->compile_end = task_times->run_start =
+                        SubmissionTimes::clock::now();
+                    if (task_times->compiled)
+                        runSubmission(i, problem_name);
+                    task_times->done = SubmissionTimes::clock::now();
+                    release();
+                },
+                info);
+    };
+
+    // Arrivals are read a bounded number at a time into the timer wheel,
+    // which hands each one to dispatch() when it is due. --time-scale
+    // stretches or compresses the arrival times.
+    TimerWheel arrivals(INGEST_TICK_MS, INGEST_WHEEL_SLOTS);
+    int read = 0;
+    while (read < num_tasks || arrivals.size() > 0) {
+        for (; read < num_tasks && arrivals.size() < INGEST_LOOKAHEAD;
+             read++) {
+            int i = read, time_arrive;
+            string problem_name, code;
+            if (!(request_file >> time_arrive >> problem_name >> code)) {
+                cerr << "Request file ends after " << i << " of "
+                     << num_tasks << " submissions\n";
+                num_tasks = i;
+                break;
+            }
+            string dir_code = "Submit/" + code + ".cpp";
+            arrivals.schedule(time_arrive * time_scale, [=, &dispatch] {
+                dispatch(i, time_arrive, problem_name, dir_code);
+            });
+        }
+        arrivals.advance();
     }
+    times.resize(num_tasks);
 
     // calculate total time to process all tasks
-    while (true) {
-        if (pool.finish_all_tasks()) {
-            auto end_time = std::chrono::high_resolution_clock::now();
-            int total_time = chrono::duration_cast<chrono::milliseconds>(
-                                 end_time - start_time)
-                                 .count();
-            cout << "the OJ system takes " << total_time
-                 << " milliseconds to finish\n";
-            break;
+    if (coordinator)
+        coordinator->wait_idle();
+    else if (pipeline)
+        pipeline->wait_idle();
+    else
+        pool->wait_idle();
+
+    // Surface anything a judging task threw
+    for (int i = 0; i < num_tasks; i++) {
+        if (!judged[i].valid()) // refused
+            continue;
+        try {
+            judged[i].get();
+        } catch (const exception &e) {
+            cerr << "Task " << i << " failed: " << e.what() << '\n';
+        }
+    }
+    // Every verdict is out before the summary
+    resultLog().close();
+
+    // Stage durations per source, replayed by --simulate; workers do not
+    // report their compiles separately
+    for (int i = 0; i < num_tasks && !coordinator; i++) {
+        if (dropped[i])
+            continue;
+        const SubmissionTimes &t = times[i];
+        auto millis = [](SubmissionTimes::clock::duration d) {
+            return chrono::duration<double, milli>(d).count();
+        };
+        costs.record(compileCostKey(sources[i]),
+                     millis(t.compile_end - t.compile_start));
+        if (t.compiled)
+            costs.record(runCostKey(problems[i], sources[i]),
+                         millis(t.done - t.run_start));
+    }
+
+    auto end_time = std::chrono::high_resolution_clock::now();
+    int total_time =
+        chrono::duration_cast<chrono::milliseconds>(end_time - start_time)
+            .count();
+    cout << "the OJ system takes " << total_time << " milliseconds to finish\n";
+    vector<double> latencies_ms;
+    for (int i = 0; i < num_tasks; i++)
+        if (!dropped[i])
+            latencies_ms.push_back(chrono::duration<double, milli>(
+                                       times[i].done - times[i].submitted)
+                                       .count());
+    cout << "Latency p50 " << (long)percentile(latencies_ms, 50) << " ms, p99 "
+         << (long)percentile(latencies_ms, 99) << " ms, max "
+         << (long)percentile(latencies_ms, 100) << " ms\n";
+    if (pipeline)
+        pipeline->report(cout);
+    if (coordinator)
+        coordinator->report(cout);
+
+    if (!bench_json.empty()) {
+        long long wall_us = chrono::duration_cast<chrono::microseconds>(
+                                end_time - start_time)
+                                .count();
+        LoadReport report(times, wall_us / 1000.0, dropped);
+        if (pipeline) {
+            report.addUtilization("compile",
+                                  pipeline->compileUtilization(wall_us));
+            report.addUtilization("run", pipeline->runUtilization(wall_us));
+        } else if (pool) {
+            report.addUtilization("pool", pool->utilization(wall_us));
+        }
+        report.printTable(cout);
+        ofstream json(bench_json);
+        report.writeJson(json);
+    }
+
+    if (!trace_file.empty()) {
+        // Queueing is not tied to a thread, so it is added from the stage
+        // timestamps: before the compile and, in the pipeline, before the run
+        for (int i = 0; i < num_tasks; i++) {
+            const SubmissionTimes &t = times[i];
+            traceAsync("submission", i, t.submitted, t.done);
+            traceAsync("queued", i, t.submitted, t.compile_start);
+            if (t.compiled && t.run_start > t.compile_end)
+                traceAsync("queued", i, t.compile_end, t.run_start);
         }
-        this_thread::sleep_for(chrono::milliseconds(100));
+        if (!writeTrace(trace_file))
+            cerr << "Cannot write trace to " << trace_file << '\n';
     }
+
+    // Final metrics write, now that every submission is counted
+    metrics.reset();
+
+    costs.save(JOB_COSTS_FILE);
+    testStats().save(TEST_STATS_FILE);
     return 0;
 }
\ No newline at end of file
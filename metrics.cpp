@@ -0,0 +1,212 @@
+#include "metrics.h"
+
+#include <atomic>
+#include <cstdio>  // for rename
+#include <fstream> // for the exported file
+#include <iomanip> // for setprecision
+#include <memory>  // for unique_ptr
+#include <ostream>
+#include <vector>
+
+using namespace std;
+
+// Counters of one thread. Only the owning thread writes, so updates are a
+// relaxed load and store instead of a locked read-modify-write.
+struct ThreadMetrics {
+    struct Phase {
+        atomic<uint64_t> count{0}, sum_us{0}, max_us{0};
+        atomic<uint64_t> buckets[NUM_BUCKETS] = {};
+    };
+    atomic<uint64_t> counters[NUM_COUNTERS] = {};
+    Phase phases[NUM_PHASES];
+};
+
+static mutex blocks_mutex;
+static vector<unique_ptr<ThreadMetrics>> blocks; // every block ever made
+static vector<ThreadMetrics *> free_blocks;      // of finished threads
+
+// Takes a block on a thread's first event, hands it back when it exits
+struct ThreadSlot {
+    ThreadMetrics *block;
+
+    ThreadSlot() {
+        lock_guard<mutex> lock(blocks_mutex);
+        if (!free_blocks.empty()) {
+            block = free_blocks.back();
+            free_blocks.pop_back();
+        } else {
+            blocks.emplace_back(new ThreadMetrics());
+            block = blocks.back().get();
+        }
+    }
+    ~ThreadSlot() {
+        lock_guard<mutex> lock(blocks_mutex);
+        free_blocks.push_back(block);
+    }
+};
+
+static ThreadMetrics &localBlock() {
+    thread_local ThreadSlot slot;
+    return *slot.block;
+}
+
+static void bump(atomic<uint64_t> &value, uint64_t n) {
+    value.store(value.load(memory_order_relaxed) + n, memory_order_relaxed);
+}
+
+void countEvent(Counter counter, uint64_t n) {
+    bump(localBlock().counters[(int)counter], n);
+}
+
+void countVerdict(const string &verdict) {
+    static const pair<const char *, Counter> verdicts[] = {
+        {"AC", Counter::VERDICT_AC},   {"WA", Counter::VERDICT_WA},
+        {"TLE", Counter::VERDICT_TLE}, {"MLE", Counter::VERDICT_MLE},
+        {"OLE", Counter::VERDICT_OLE}, {"CE", Counter::VERDICT_CE}};
+    for (const auto &entry : verdicts)
+        if (verdict == entry.first)
+            countEvent(entry.second);
+}
+
+void recordPhase(Phase phase, long long micros) {
+    uint64_t us = micros > 0 ? (uint64_t)micros : 0;
+    ThreadMetrics::Phase &stats = localBlock().phases[(int)phase];
+    bump(stats.count, 1);
+    bump(stats.sum_us, us);
+    if (us > stats.max_us.load(memory_order_relaxed))
+        stats.max_us.store(us, memory_order_relaxed);
+    int bucket = 0;
+    while (bucket < NUM_BUCKETS - 1 &&
+           (long long)us > BUCKET_BOUNDS_US[bucket])
+        bucket++;
+    bump(stats.buckets[bucket], 1);
+}
+
+MetricsSnapshot snapshotMetrics() {
+    MetricsSnapshot snapshot;
+    lock_guard<mutex> lock(blocks_mutex);
+    for (const auto &block : blocks) {
+        for (int c = 0; c < NUM_COUNTERS; c++)
+            snapshot.counters[c] +=
+                block->counters[c].load(memory_order_relaxed);
+        for (int p = 0; p < NUM_PHASES; p++) {
+            const ThreadMetrics::Phase &from = block->phases[p];
+            PhaseTotals &to = snapshot.phases[p];
+            to.count += from.count.load(memory_order_relaxed);
+            to.sum_us += from.sum_us.load(memory_order_relaxed);
+            to.max_us =
+                max(to.max_us, from.max_us.load(memory_order_relaxed));
+            for (int b = 0; b < NUM_BUCKETS; b++)
+                to.buckets[b] += from.buckets[b].load(memory_order_relaxed);
+        }
+    }
+    return snapshot;
+}
+
+static const char *PHASE_NAMES[NUM_PHASES] = {
+    "queue_wait", "compile", "test_run", "compare", "cleanup"};
+
+static const char *COUNTER_NAMES[NUM_COUNTERS] = {
+    "submissions", "verdict_ac",    "verdict_wa",  "verdict_tle",
+    "verdict_mle", "verdict_ole",   "verdict_ce",  "tests_run",
+    "process_kills", "cache_hits", "cache_misses", "tests_reused",
+    "submissions_coalesced", "submissions_rejected", "submissions_shed"};
+
+void writePrometheus(ostream &out, const MetricsSnapshot &snapshot) {
+    out << setprecision(9);
+    out << "# HELP oj_phase_seconds Time spent in each judging phase.\n";
+    out << "# TYPE oj_phase_seconds histogram\n";
+    for (int p = 0; p < NUM_PHASES; p++) {
+        const PhaseTotals &phase = snapshot.phases[p];
+        uint64_t cumulative = 0;
+        for (int b = 0; b < NUM_BUCKETS; b++) {
+            cumulative += phase.buckets[b];
+            out << "oj_phase_seconds_bucket{phase=\"" << PHASE_NAMES[p]
+                << "\",le=\"";
+            if (b < NUM_BUCKETS - 1)
+                out << BUCKET_BOUNDS_US[b] / 1e6;
+            else
+                out << "+Inf";
+            out << "\"} " << cumulative << '\n';
+        }
+        out << "oj_phase_seconds_sum{phase=\"" << PHASE_NAMES[p] << "\"} "
+            << phase.sum_us / 1e6 << '\n';
+        out << "oj_phase_seconds_count{phase=\"" << PHASE_NAMES[p] << "\"} "
+            << phase.count << '\n';
+    }
+
+    static const char *VERDICTS[] = {"AC", "WA", "TLE", "MLE", "OLE", "CE"};
+    out << "# HELP oj_verdicts_total Submissions by final verdict.\n";
+    out << "# TYPE oj_verdicts_total counter\n";
+    for (int v = 0; v < 6; v++)
+        out << "oj_verdicts_total{verdict=\"" << VERDICTS[v] << "\"} "
+            << snapshot.counters[(int)Counter::VERDICT_AC + v] << '\n';
+
+    const Counter plain[] = {Counter::SUBMISSIONS, Counter::TESTS_RUN,
+                             Counter::PROCESS_KILLS, Counter::CACHE_HITS,
+                             Counter::CACHE_MISSES, Counter::TESTS_REUSED,
+                             Counter::SUBMISSIONS_COALESCED,
+                             Counter::SUBMISSIONS_REJECTED,
+                             Counter::SUBMISSIONS_SHED};
+    for (Counter c : plain) {
+        out << "# TYPE oj_" << COUNTER_NAMES[(int)c] << "_total counter\n";
+        out << "oj_" << COUNTER_NAMES[(int)c] << "_total "
+            << snapshot.counters[(int)c] << '\n';
+    }
+    out << defaultfloat;
+}
+
+void writeMetricsJson(ostream &out, const MetricsSnapshot &snapshot) {
+    out << setprecision(6);
+    out << "{\n  \"phases\": {\n";
+    for (int p = 0; p < NUM_PHASES; p++) {
+        const PhaseTotals &phase = snapshot.phases[p];
+        out << "    \"" << PHASE_NAMES[p] << "\": {\"count\": " << phase.count
+            << ", \"sum_ms\": " << phase.sum_us / 1000.0
+            << ", \"max_ms\": " << phase.max_us / 1000.0 << "}"
+            << (p + 1 < NUM_PHASES ? "," : "") << '\n';
+    }
+    out << "  },\n  \"counters\": {\n";
+    for (int c = 0; c < NUM_COUNTERS; c++)
+        out << "    \"" << COUNTER_NAMES[c] << "\": " << snapshot.counters[c]
+            << (c + 1 < NUM_COUNTERS ? "," : "") << '\n';
+    out << "  }\n}\n";
+    out << defaultfloat;
+}
+
+MetricsExporter::MetricsExporter(const string &path, int interval_ms)
+    : path(path), interval_ms(interval_ms) {
+    writer = thread([this] {
+        unique_lock<mutex> lock(stop_mutex);
+        while (!stop) {
+            stop_condition.wait_for(lock,
+                                    chrono::milliseconds(this->interval_ms));
+            write();
+        }
+    });
+}
+
+void MetricsExporter::write() {
+    MetricsSnapshot snapshot = snapshotMetrics();
+    string tmp = path + ".tmp";
+    {
+        ofstream out(tmp);
+        bool json = path.size() >= 5 &&
+                    path.compare(path.size() - 5, 5, ".json") == 0;
+        if (json)
+            writeMetricsJson(out, snapshot);
+        else
+            writePrometheus(out, snapshot);
+    }
+    rename(tmp.c_str(), path.c_str());
+}
+
+MetricsExporter::~MetricsExporter() {
+    {
+        lock_guard<mutex> lock(stop_mutex);
+        stop = true;
+    }
+    // The writer wakes up and writes the final snapshot on its way out
+    stop_condition.notify_all();
+    writer.join();
+}
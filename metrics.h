@@ -0,0 +1,124 @@
+// metrics.h
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <iosfwd>
+#include <mutex>
+#include <string>
+#include <thread>
+
+/*
+ * Always-on judge instrumentation.
+ *
+ * Every thread writes to its own block of counters, so recording is a few
+ * uncontended relaxed stores and never takes a lock. Readers merge all the
+ * blocks into a snapshot. Blocks of finished threads are kept (and reused by
+ * new threads), so totals never go backwards.
+ */
+
+// Timed phases of judging
+enum class Phase {
+    QUEUE_WAIT, // queued in a pool before a worker picked the task up
+    COMPILE,    // compileSubmission()
+    TEST_RUN,   // one test's process, from fork to reap
+    COMPARE,    // comparing one test's output
+    CLEANUP,    // removing outputs and the executable
+    COUNT
+};
+
+enum class Counter {
+    SUBMISSIONS,
+    VERDICT_AC,
+    VERDICT_WA,
+    VERDICT_TLE,
+    VERDICT_MLE,
+    VERDICT_OLE,
+    VERDICT_CE,
+    TESTS_RUN,
+    PROCESS_KILLS, // process groups killed: limits, cancels, early WA
+    CACHE_HITS,    // compile cache served a binary
+    CACHE_MISSES,  // compile cache ran g++
+    TESTS_REUSED,  // test results taken from the verdict cache (rejudge)
+    SUBMISSIONS_COALESCED, // judged by an identical one already in flight
+    SUBMISSIONS_REJECTED,  // turned away by admission control
+    SUBMISSIONS_SHED,      // dropped as a duplicate by admission control
+    COUNT
+};
+
+const int NUM_PHASES = (int)Phase::COUNT;
+const int NUM_COUNTERS = (int)Counter::COUNT;
+
+// Upper bounds of the phase duration histogram, in microseconds; the last
+// bucket is +Inf
+const int NUM_BUCKETS = 11;
+const long long BUCKET_BOUNDS_US[NUM_BUCKETS - 1] = {
+    100, 1000, 5000, 10000, 50000, 100000, 500000, 1000000, 2000000, 5000000};
+
+void countEvent(Counter counter, uint64_t n = 1);
+// "AC", "WA", "TLE", "MLE", "OLE" or "CE"
+void countVerdict(const std::string &verdict);
+void recordPhase(Phase phase, long long micros);
+
+// Records the time from construction to destruction as one `phase`
+class PhaseTimer {
+  private:
+    Phase phase;
+    std::chrono::steady_clock::time_point start;
+
+  public:
+    explicit PhaseTimer(Phase phase)
+        : phase(phase), start(std::chrono::steady_clock::now()) {}
+    ~PhaseTimer() {
+        using namespace std::chrono;
+        recordPhase(phase,
+                    duration_cast<microseconds>(steady_clock::now() - start)
+                        .count());
+    }
+};
+
+struct PhaseTotals {
+    uint64_t count = 0;
+    uint64_t sum_us = 0;
+    uint64_t max_us = 0;
+    uint64_t buckets[NUM_BUCKETS] = {}; // not cumulative
+};
+
+struct MetricsSnapshot {
+    uint64_t counters[NUM_COUNTERS] = {};
+    PhaseTotals phases[NUM_PHASES];
+};
+
+// Merge the blocks of every thread
+MetricsSnapshot snapshotMetrics();
+
+// Prometheus text exposition format
+void writePrometheus(std::ostream &out, const MetricsSnapshot &snapshot);
+void writeMetricsJson(std::ostream &out, const MetricsSnapshot &snapshot);
+
+/*
+ * Rewrites `path` with a fresh snapshot every `interval_ms` and once more
+ * when destroyed. A path ending in ".json" gets JSON, anything else the
+ * Prometheus text format (e.g. for node_exporter's textfile collector).
+ * Each write goes to a temporary file renamed over `path`, so readers never
+ * see a partial file.
+ */
+class MetricsExporter {
+  private:
+    std::string path;
+    int interval_ms;
+    std::thread writer;
+    std::mutex stop_mutex;
+    std::condition_variable stop_condition;
+    bool stop = false;
+
+    void write();
+
+  public:
+    MetricsExporter(const std::string &path, int interval_ms);
+    ~MetricsExporter();
+};
+
+#endif // METRICS_H
@@ -0,0 +1,41 @@
+// oj_checker.h
+#ifndef OJ_CHECKER_H
+#define OJ_CHECKER_H
+
+#include <stddef.h>
+
+/*
+ * Interface of a special-judge checker, for problems whose answers cannot
+ * be compared with `diff -w` (floating-point tolerance, several valid
+ * answers). Put the checker's source in the problem's directory and name it
+ * in problem.txt:
+ *
+ *      checker tolerance.cpp
+ *
+ * The judge compiles it once into a shared object and calls oj_check() for
+ * every test with the test's input, the participant's output and the
+ * expected answer, each mapped into memory (not NUL-terminated). It returns
+ * OJ_ACCEPTED or OJ_WRONG_ANSWER; anything else is an internal error (IE).
+ *
+ * By default the checker runs inside the judge and may be called from
+ * several threads at once, so it must not keep state between calls, and a
+ * crash in it takes the judge down. With "checker_mode process" in
+ * problem.txt (or --isolate-checkers) it runs in separate processes
+ * instead, for checkers that are not trusted; there a crash or a hang is
+ * an IE for that test.
+ */
+#define OJ_ACCEPTED 0
+#define OJ_WRONG_ANSWER 1
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int oj_check(const char *input, size_t input_size, const char *output,
+             size_t output_size, const char *answer, size_t answer_size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // OJ_CHECKER_H
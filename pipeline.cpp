@@ -0,0 +1,130 @@
+#include "pipeline.h"
+#include "judger.h"
+
+#include <algorithm> // for std::min
+#include <iomanip>   // for setprecision
+#include <memory>    // for make_shared
+#include <ostream>
+
+using namespace std;
+
+void splitCpus(int run_workers, int compile_cores, vector<int> &compile_cpus,
+               vector<int> &run_cpus) {
+    compile_cpus.clear();
+    run_cpus.clear();
+    vector<int> cpus = availableCpus();
+    if (cpus.size() < 2)
+        return;
+    size_t num_run = compile_cores > 0
+                         ? cpus.size() - min((size_t)compile_cores,
+                                             cpus.size() - 1)
+                         : min((size_t)max(run_workers, 1), cpus.size() - 1);
+    compile_cpus.assign(cpus.begin(), cpus.end() - num_run);
+    run_cpus.assign(cpus.end() - num_run, cpus.end());
+}
+
+JudgePipeline::JudgePipeline(int compile_workers, int run_workers,
+                             size_t queue_capacity,
+                             const vector<int> &compile_cpus,
+                             const vector<int> &run_cpus,
+                             SchedulePolicy policy, CostModel *costs)
+    : run_pool(run_workers, run_cpus, policy, costs, true),
+      compile_pool(compile_workers, compile_cpus),
+      queue_capacity(max<size_t>(queue_capacity, 1)) {
+    start_time = last_change = chrono::steady_clock::now();
+}
+
+// Caller holds handoff_mutex
+void JudgePipeline::changeDepth(int delta) {
+    auto now = chrono::steady_clock::now();
+    depth_us += (double)depth *
+                chrono::duration_cast<chrono::microseconds>(now - last_change)
+                    .count();
+    last_change = now;
+    depth += delta;
+    max_depth = max(max_depth, depth);
+}
+
+future<void> JudgePipeline::submit(int task_id, const string &dir_code,
+                                   const string &problem_name,
+                                   const TaskInfo &info,
+                                   function<void()> on_done,
+                                   SubmissionTimes *times) {
+    // Fulfilled by whichever stage finishes the submission
+    auto done = make_shared<promise<void>>();
+    auto finish = [done, on_done, times] {
+        if (times)
+            times->done = SubmissionTimes::clock::now();
+        if (on_done)
+            on_done();
+        done->set_value();
+    };
+
+    compile_pool.add_task([=] {
+        if (times)
+            times->compile_start = SubmissionTimes::clock::now();
+        bool compiled = compileSubmission(task_id, dir_code, problem_name);
+        if (times) {
+            times->compile_end = SubmissionTimes::clock::now();
+            times->compiled = compiled;
+        }
+        if (!compiled) {
+            finish();
+            return;
+        }
+
+        {
+            // Back-pressure: wait for room in the hand-off queue
+            unique_lock<mutex> lock(handoff_mutex);
+            handoff_space.wait(lock, [this] { return depth < queue_capacity; });
+            changeDepth(+1);
+            handoffs++;
+        }
+
+        run_pool.add_task(
+            [=] {
+                {
+                    lock_guard<mutex> lock(handoff_mutex);
+                    changeDepth(-1);
+                }
+                handoff_space.notify_one();
+                if (times)
+                    times->run_start = SubmissionTimes::clock::now();
+                runSubmission(task_id, problem_name);
+                finish();
+            },
+            info);
+    });
+    return done->get_future();
+}
+
+void JudgePipeline::wait_idle() {
+    // Compile first: a compile task hands off to the run pool before it
+    // finishes, so once the compile pool is idle every hand-off is counted
+    // by the run pool
+    compile_pool.wait_idle();
+    run_pool.wait_idle();
+}
+
+void JudgePipeline::report(ostream &out) {
+    lock_guard<mutex> lock(handoff_mutex);
+    auto now = chrono::steady_clock::now();
+    long long wall_us =
+        chrono::duration_cast<chrono::microseconds>(now - start_time).count();
+    double area = depth_us + (double)depth *
+                                 chrono::duration_cast<chrono::microseconds>(
+                                     now - last_change)
+                                     .count();
+
+    out << fixed << setprecision(1);
+    out << "Pipeline: " << handoffs << " hand-offs, queue capacity "
+        << queue_capacity << ", max depth " << max_depth << ", mean depth "
+        << (wall_us > 0 ? area / wall_us : 0.0) << '\n';
+    out << "  compile stage: " << compile_pool.num_workers()
+        << " workers, utilization "
+        << 100 * compile_pool.utilization(wall_us) << "%\n";
+    out << "  run stage:     " << run_pool.num_workers()
+        << " workers, utilization " << 100 * run_pool.utilization(wall_us)
+        << "%\n";
+    out << defaultfloat;
+}
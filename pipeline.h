@@ -0,0 +1,90 @@
+// pipeline.h
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include "load_report.h"
+#include "thread_pool.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <iosfwd>
+#include <mutex>
+#include <string>
+
+/*
+ * Two-stage judging: a compile pool feeds compiled submissions through a
+ * bounded hand-off queue into a separate run pool.
+ *
+ * g++ jobs and timed runs no longer compete for the same workers, and the
+ * next submission compiles while the current one runs. When there are enough
+ * CPUs, the run workers get a dedicated set of cores and the compile workers
+ * (and the g++ processes they start) are kept on the others. A compile
+ * worker whose submission finds the hand-off queue full waits, so a burst of
+ * compiles cannot run arbitrarily far ahead of the run stage.
+ */
+class JudgePipeline {
+  private:
+    // Declared first so it is destroyed last: compile tasks still hand off
+    // to it while the compile pool drains
+    ThreadPool run_pool;
+    ThreadPool compile_pool;
+
+    size_t queue_capacity;
+
+    // Submissions compiled and waiting for a run worker
+    std::mutex handoff_mutex;
+    std::condition_variable handoff_space;
+    size_t depth = 0;
+    size_t max_depth = 0;
+    size_t handoffs = 0;
+
+    // Time-weighted queue depth, for the mean
+    std::chrono::steady_clock::time_point start_time, last_change;
+    double depth_us = 0;
+
+    void changeDepth(int delta);
+
+  public:
+    // The run pool orders its queue with `policy` and `costs`; compiles are
+    // taken in arrival order. Run worker i is pinned to run_cpus[i], so the
+    // processes it times do not migrate or share a core.
+    JudgePipeline(int compile_workers, int run_workers,
+                  size_t queue_capacity, const std::vector<int> &compile_cpus,
+                  const std::vector<int> &run_cpus,
+                  SchedulePolicy policy = SchedulePolicy::FIFO,
+                  CostModel *costs = nullptr);
+
+    // `on_done` (optional) runs once the submission has a verdict or failed
+    // to compile; the returned future becomes ready right after it. The
+    // stages fill in `times` (optional, `submitted` is left to the caller).
+    std::future<void> submit(int task_id, const std::string &dir_code,
+                             const std::string &problem_name,
+                             const TaskInfo &info = {},
+                             std::function<void()> on_done = nullptr,
+                             SubmissionTimes *times = nullptr);
+
+    // Block until every submitted submission went through both stages
+    void wait_idle();
+
+    // Queue depth and per-stage utilization since construction
+    void report(std::ostream &out);
+
+    // Busy fraction of each stage's workers over `wall_us`
+    double compileUtilization(long long wall_us) const {
+        return compile_pool.utilization(wall_us);
+    }
+    double runUtilization(long long wall_us) const {
+        return run_pool.utilization(wall_us);
+    }
+};
+
+// Split the CPUs between compiles and timed runs: `compile_cores` cores for
+// compiles and the rest for runs, or, when `compile_cores` is 0,
+// `run_workers` cores for runs and the rest for compiles. Each side keeps at
+// least one core; both stay empty (no pinning) on a single CPU.
+void splitCpus(int run_workers, int compile_cores,
+               std::vector<int> &compile_cpus, std::vector<int> &run_cpus);
+
+#endif // PIPELINE_H
@@ -0,0 +1,259 @@
+#include "problems.h"
+#include "checker.h"
+#include "hashing.h"
+
+#include <algorithm>  // for std::sort
+#include <cctype>     // for isdigit
+#include <chrono>     // for spacing out the test file walks
+#include <filesystem> // for the problem directories
+#include <fstream>    // for the manifest
+#include <iostream>   // for warnings
+#include <sstream>    // for parsing manifest lines
+
+using namespace std;
+namespace fs = std::filesystem;
+
+const string PROBLEM_ROOT = "problem";
+const string MANIFEST = "problem.txt";
+const string TESTCASE_DIR = "testcases";
+const string EXPECTED_DIR = "expected_outputs";
+// How often get() looks at every test file of a problem rather than only at
+// its directories
+const chrono::seconds PROBLEM_WALK_INTERVAL(2);
+
+// Natural order: runs of digits compare by value, so input2 < input10
+static bool naturalLess(const string &a, const string &b) {
+    size_t i = 0, j = 0;
+    while (i < a.size() && j < b.size()) {
+        if (isdigit((unsigned char)a[i]) && isdigit((unsigned char)b[j])) {
+            size_t end_a = i, end_b = j;
+            while (end_a < a.size() && isdigit((unsigned char)a[end_a]))
+                end_a++;
+            while (end_b < b.size() && isdigit((unsigned char)b[end_b]))
+                end_b++;
+            // Compare by value: strip leading zeros, then length, then digits
+            size_t zi = i, zj = j;
+            while (zi + 1 < end_a && a[zi] == '0')
+                zi++;
+            while (zj + 1 < end_b && b[zj] == '0')
+                zj++;
+            if (end_a - zi != end_b - zj)
+                return end_a - zi < end_b - zj;
+            int order = a.compare(zi, end_a - zi, b, zj, end_b - zj);
+            if (order != 0)
+                return order < 0;
+            i = end_a;
+            j = end_b;
+        } else {
+            if (a[i] != b[j])
+                return a[i] < b[j];
+            i++;
+            j++;
+        }
+    }
+    return a.size() - i < b.size() - j;
+}
+
+// input7.inp -> output7.out, anything else.inp -> anything else.out
+static string expectedNameFor(const string &input_name) {
+    string stem = fs::path(input_name).stem().string();
+    if (stem.compare(0, 5, "input") == 0)
+        return "output" + stem.substr(5) + ".out";
+    return stem + ".out";
+}
+
+// Fill in sizes and hashes; false if either file cannot be read
+static bool indexTest(TestCase &test) {
+    MappedFile input(test.input_file), expected(test.expected_file);
+    if (!input.ok || !expected.ok)
+        return false;
+    test.input_bytes = input.size;
+    test.expected_bytes = expected.size;
+    test.input_hash = fnv1a(input.data, input.size);
+    test.expected_hash = fnv1a(expected.data, expected.size);
+    return true;
+}
+
+ProblemRegistry::ProblemRegistry(const string &root) : root(root) {}
+
+uint64_t ProblemRegistry::stampOf(const string &name) const {
+    fs::path dir = fs::path(root) / name;
+    uint64_t hash = FNV_OFFSET;
+    for (const fs::path &path : {dir, dir / TESTCASE_DIR, dir / EXPECTED_DIR,
+                                 dir / MANIFEST}) {
+        error_code ec;
+        auto ticks = fs::last_write_time(path, ec).time_since_epoch().count();
+        if (ec)
+            ticks = 0;
+        hash = fnv1a((const char *)&ticks, sizeof(ticks), hash);
+    }
+    return hash;
+}
+
+uint64_t ProblemRegistry::signatureOf(const string &name) const {
+    fs::path dir = fs::path(root) / name;
+    uint64_t hash = stampOf(name);
+    // Editing a test in place leaves its directory's mtime alone
+    for (const fs::path &sub : {dir / TESTCASE_DIR, dir / EXPECTED_DIR}) {
+        vector<fs::path> files;
+        error_code ec;
+        for (fs::directory_iterator it(sub, ec), end; !ec && it != end;
+             it.increment(ec))
+            files.push_back(it->path());
+        sort(files.begin(), files.end());
+        for (const fs::path &file : files) {
+            auto ticks =
+                fs::last_write_time(file, ec).time_since_epoch().count();
+            if (ec)
+                ticks = 0;
+            uintmax_t size = fs::file_size(file, ec);
+            if (ec)
+                size = 0;
+            hash = fnv1a(file.filename().string() + '\0', hash);
+            hash = fnv1a((const char *)&ticks, sizeof(ticks), hash);
+            hash = fnv1a((const char *)&size, sizeof(size), hash);
+        }
+    }
+    return hash;
+}
+
+shared_ptr<const Problem> ProblemRegistry::load(const string &name) const {
+    fs::path dir = fs::path(root) / name;
+    error_code ec;
+    if (!fs::is_directory(dir / TESTCASE_DIR, ec))
+        return nullptr;
+
+    // Taken before reading, so a change made while loading triggers another
+    // reload on the next get()
+    auto problem = make_shared<Problem>();
+    problem->name = name;
+    problem->stamp = stampOf(name);
+    problem->signature = signatureOf(name);
+
+    vector<pair<string, string>> listed; // input, expected file names
+    ifstream manifest(dir / MANIFEST);
+    string line;
+    while (getline(manifest, line)) {
+        istringstream fields(line);
+        string key;
+        if (!(fields >> key) || key[0] == '#')
+            continue;
+        ProblemSettings &settings = problem->settings;
+        if (key == "time_limit_ms") {
+            fields >> settings.time_limit_ms;
+        } else if (key == "memory_limit_mb") {
+            fields >> settings.memory_limit_mb;
+        } else if (key == "checker") {
+            fields >> settings.checker;
+            if (settings.checker != "diff") {
+                settings.checker_source = (dir / settings.checker).string();
+                MappedFile source(settings.checker_source);
+                settings.checker_hash =
+                    source.ok ? fnv1a(source.data, source.size) : 0;
+            }
+        } else if (key == "checker_mode") {
+            string mode;
+            fields >> mode;
+            settings.checker_isolated = mode == "process";
+        } else if (key == "test") {
+            string input, expected;
+            if (fields >> input >> expected)
+                listed.push_back({input, expected});
+        } else {
+            cerr << "Problem " << name << ": unknown setting " << key << '\n';
+        }
+    }
+
+    if (listed.empty()) {
+        vector<string> inputs;
+        for (const auto &entry : fs::directory_iterator(dir / TESTCASE_DIR, ec))
+            if (entry.path().extension() == ".inp")
+                inputs.push_back(entry.path().filename().string());
+        sort(inputs.begin(), inputs.end(), naturalLess);
+        for (const string &input : inputs)
+            listed.push_back({input, expectedNameFor(input)});
+    }
+
+    for (const auto &files : listed) {
+        TestCase test;
+        test.name = files.first;
+        test.input_file = (dir / TESTCASE_DIR / files.first).string();
+        test.expected_file = (dir / EXPECTED_DIR / files.second).string();
+        if (!indexTest(test)) {
+            cerr << "Problem " << name << ": test " << files.first
+                 << " will be judged IE, cannot read " << test.input_file
+                 << " or " << test.expected_file << '\n';
+            test.readable = false;
+        }
+        problem->tests.push_back(test);
+    }
+    return problem;
+}
+
+size_t ProblemRegistry::loadAll() {
+    map<string, shared_ptr<const Problem>> loaded;
+    error_code ec;
+    for (const auto &entry : fs::directory_iterator(root, ec)) {
+        if (!entry.is_directory())
+            continue;
+        string name = entry.path().filename().string();
+        if (auto problem = load(name))
+            loaded[name] = problem;
+    }
+
+    auto now = chrono::steady_clock::now();
+    lock_guard<mutex> lock(registry_mutex);
+    problems = move(loaded);
+    walked.clear();
+    for (const auto &problem : problems)
+        walked[problem.first] = now;
+    return problems.size();
+}
+
+shared_ptr<const Problem> ProblemRegistry::get(const string &name) {
+    auto now = chrono::steady_clock::now();
+    shared_ptr<const Problem> current;
+    bool walk = false;
+    {
+        lock_guard<mutex> lock(registry_mutex);
+        auto it = problems.find(name);
+        if (it != problems.end()) {
+            current = it->second;
+            walk = now - walked[name] >= PROBLEM_WALK_INTERVAL;
+        }
+    }
+    if (!current || current->stamp != stampOf(name))
+        return reload(name);
+    if (!walk)
+        return current;
+
+    // Due for a look at every test file, for tests edited in place
+    uint64_t signature = signatureOf(name);
+    {
+        lock_guard<mutex> lock(registry_mutex);
+        walked[name] = now;
+    }
+    return signature == current->signature ? current : reload(name);
+}
+
+shared_ptr<const Problem> ProblemRegistry::reload(const string &name) {
+    // Loaded outside the lock: hashing the tests of one problem must not
+    // hold up submissions of the others
+    auto now = chrono::steady_clock::now();
+    shared_ptr<const Problem> problem = load(name);
+
+    lock_guard<mutex> lock(registry_mutex);
+    if (problem) {
+        problems[name] = problem;
+        walked[name] = now;
+    } else {
+        problems.erase(name);
+        walked.erase(name);
+    }
+    return problem;
+}
+
+ProblemRegistry &problemRegistry() {
+    static ProblemRegistry registry(PROBLEM_ROOT);
+    return registry;
+}
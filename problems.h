@@ -0,0 +1,118 @@
+// problems.h
+#ifndef PROBLEMS_H
+#define PROBLEMS_H
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/*
+ * One test of a problem:
+ *      name           - input file name, as shown in verdicts
+ *      input_file     - path of the input
+ *      expected_file  - path of the expected output
+ *      input_bytes, expected_bytes - file sizes
+ *      input_hash, expected_hash   - FNV-1a of the file contents
+ *      readable       - false if either file could not be read at load
+ *                       time; such a test is judged IE, never AC
+ */
+struct TestCase {
+    std::string name;
+    std::string input_file;
+    std::string expected_file;
+    uint64_t input_bytes = 0;
+    uint64_t expected_bytes = 0;
+    uint64_t input_hash = 0;
+    uint64_t expected_hash = 0;
+    bool readable = true;
+};
+
+/*
+ * Settings read from problem/<name>/problem.txt, one "key value" per line:
+ *      time_limit_ms   - CPU time (user + system) limit of one test
+ *                        (default 2000); a run that sleeps or blocks is
+ *                        stopped after 3x this much time off the CPU
+ *      memory_limit_mb - memory limit of one test; 0 (the default) uses the
+ *                        judge-wide --memory-limit
+ *      checker         - how outputs are compared: "diff" (the default,
+ *                        whitespace-insensitive like `diff -w`), or the
+ *                        file name of a checker source in the problem's
+ *                        directory (see oj_checker.h)
+ *      checker_mode    - "inprocess" (the default) or "process", to run
+ *                        that checker in a separate host process
+ *      test <input> <expected> - list the tests explicitly, in this order,
+ *                        instead of discovering them
+ * Lines starting with '#' are comments.
+ */
+struct ProblemSettings {
+    int time_limit_ms = 2000;
+    long memory_limit_mb = 0;
+    std::string checker = "diff";
+    std::string checker_source; // path of the checker source, "" for diff
+    uint64_t checker_hash = 0;  // FNV-1a of its contents
+    bool checker_isolated = false;
+};
+
+// A problem as loaded by the registry. Never modified once published, so
+// workers can use it without locking.
+struct Problem {
+    std::string name;
+    ProblemSettings settings;
+    std::vector<TestCase> tests; // in judging order
+    uint64_t stamp = 0;          // of its directory and manifest mtimes
+    uint64_t signature = 0;      // stamp and every test file's mtime, size
+};
+
+/*
+ * Index of every problem under a root directory, built once at startup
+ * instead of scanning the test directories for every submission.
+ *
+ * Without a manifest test list, every testcases/<stem>.inp is paired with
+ * expected_outputs/output<rest>.out when <stem> is input<rest>, else with
+ * expected_outputs/<stem>.out, and the tests are sorted in natural order
+ * (input2 before input10). A listed test whose files cannot be read stays
+ * in the list, marked unreadable, so it fails submissions instead of
+ * silently shrinking the test set.
+ *
+ * get() compares the mtimes of the problem's directories and manifest with
+ * the ones it was loaded from and reloads it when they differ, so adding,
+ * removing or renaming tests is picked up at once. Tests edited in place
+ * only change the files themselves: at most every PROBLEM_WALK_INTERVAL,
+ * get() also compares the mtime and size of every test file, and reload()
+ * picks them up at once. Submissions already judging keep the snapshot
+ * they started with.
+ */
+class ProblemRegistry {
+  private:
+    std::string root;
+    std::mutex registry_mutex;
+    std::map<std::string, std::shared_ptr<const Problem>> problems;
+    // When each problem's test files were last compared
+    std::map<std::string, std::chrono::steady_clock::time_point> walked;
+
+    std::shared_ptr<const Problem> load(const std::string &name) const;
+    uint64_t stampOf(const std::string &name) const;
+    uint64_t signatureOf(const std::string &name) const;
+
+  public:
+    explicit ProblemRegistry(const std::string &root);
+
+    // Load every problem directory under the root; returns how many loaded
+    size_t loadAll();
+
+    // The current snapshot of `name`, reloaded first if its directory
+    // changed; null if there is no such problem
+    std::shared_ptr<const Problem> get(const std::string &name);
+
+    // Reload `name` unconditionally, e.g. after tests were edited in place
+    std::shared_ptr<const Problem> reload(const std::string &name);
+};
+
+// The registry of problem/, shared by all workers
+ProblemRegistry &problemRegistry();
+
+#endif // PROBLEMS_H
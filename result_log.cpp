@@ -0,0 +1,180 @@
+#include "result_log.h"
+
+#include <iostream>
+#include <sstream>
+
+#include <sys/eventfd.h>
+#include <unistd.h> // for read, write, close
+
+using namespace std;
+
+// Escape a string for a JSON string literal
+static string jsonString(const string &text) {
+    string out = "\"";
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if ((unsigned char)c < 0x20) {
+            static const char hex[] = "0123456789abcdef";
+            out += "\\u00";
+            out += hex[(c >> 4) & 0xf];
+            out += hex[c & 0xf];
+        } else {
+            out += c;
+        }
+    }
+    return out + '"';
+}
+
+ResultLog::ResultLog() : head(new Node()), wake_fd(eventfd(0, EFD_CLOEXEC)) {
+    tail = head.load();
+    if (wake_fd >= 0)
+        writer = thread(&ResultLog::writerLoop, this);
+}
+
+ResultLog::~ResultLog() {
+    close();
+    if (wake_fd >= 0)
+        ::close(wake_fd);
+    delete tail;
+}
+
+bool ResultLog::openJsonl(const string &path) {
+    jsonl.open(path, ios::out | ios::trunc);
+    return (bool)jsonl;
+}
+
+void ResultLog::setListener(function<void(const ResultRecord &)> listener) {
+    this->listener = move(listener);
+}
+
+void ResultLog::log(ResultRecord record) {
+    if (!writer.joinable()) {
+        // No writer (eventfd unavailable or closed): write it ourselves
+        print(record);
+        cout.flush();
+        return;
+    }
+    Node *node = new Node();
+    node->record = move(record);
+    // Link after whatever was pushed last; the writer sees the node once
+    // `next` of its predecessor is set
+    Node *prev = head.exchange(node, memory_order_acq_rel);
+    prev->next.store(node, memory_order_release);
+    uint64_t one = 1;
+    ssize_t written = write(wake_fd, &one, sizeof(one));
+    (void)written;
+}
+
+bool ResultLog::pop(ResultRecord &record) {
+    Node *next = tail->next.load(memory_order_acquire);
+    if (!next)
+        return false;
+    record = move(next->record);
+    delete tail;
+    tail = next;
+    return true;
+}
+
+void ResultLog::writerLoop() {
+    while (true) {
+        // Blocks until log() or close() bumps the counter
+        uint64_t count;
+        ssize_t got = read(wake_fd, &count, sizeof(count));
+        (void)got;
+
+        ResultRecord record;
+        bool wrote = false;
+        while (pop(record)) {
+            print(record);
+            wrote = true;
+        }
+        if (wrote) {
+            cout.flush();
+            if (jsonl.is_open())
+                jsonl.flush();
+        }
+        if (stop)
+            return;
+    }
+}
+
+void ResultLog::close() {
+    if (!writer.joinable())
+        return;
+    // Called once judging is done, so no log() is in flight: the writer
+    // drains the queue on this last wake-up and exits
+    stop = true;
+    uint64_t one = 1;
+    ssize_t written = write(wake_fd, &one, sizeof(one));
+    (void)written;
+    writer.join();
+    ResultRecord record;
+    while (pop(record)) {
+        print(record);
+    }
+    cout.flush();
+    if (jsonl.is_open())
+        jsonl.flush();
+}
+
+string resultJson(const ResultRecord &record) {
+    ostringstream json;
+    json << "{\"task\": " << record.task_id
+         << ", \"problem\": " << jsonString(record.problem)
+         << ", \"verdict\": " << jsonString(record.verdict)
+         << ", \"order\": " << jsonString(record.order)
+         << ", \"failing_test\": " << record.failing_test
+         << ", \"wall_ms\": " << record.wall_ms
+         << ", \"cpu_ms\": " << record.cpu_ms
+         << ", \"peak_rss_kb\": " << record.peak_rss_kb;
+    if (record.verdict == "WA")
+        json << ", \"diff\": {\"line\": " << record.diff_line
+             << ", \"byte\": " << record.diff_offset << "}";
+    json << ", \"tests\": [";
+    for (size_t k = 0; k < record.tests.size(); k++) {
+        const TestRecord &test = record.tests[k];
+        json << (k ? ", " : "") << "{\"name\": " << jsonString(test.name)
+             << ", \"verdict\": " << jsonString(test.verdict)
+             << ", \"wall_ms\": " << test.wall_ms
+             << ", \"cpu_ms\": " << test.cpu_ms
+             << ", \"peak_rss_kb\": " << test.peak_rss_kb << "}";
+    }
+    json << "]}";
+    return json.str();
+}
+
+void ResultLog::print(const ResultRecord &record) {
+    if (jsonl.is_open())
+        jsonl << resultJson(record) << '\n';
+    if (listener)
+        listener(record);
+    if (!banners)
+        return;
+
+    cout << "\n===================================================\n";
+    cout << "Judge ID: " << record.judge_id % 1000 << '\n';
+    cout << "Task " << record.task_id << ": " << record.verdict << '\n';
+    if (record.order != "natural")
+        cout << "Test order: " << record.order << '\n';
+    // Nothing ran for a compile error or a rejected submission
+    if (record.verdict != "CE" && record.verdict != "RJ") {
+        cout << "Time: " << record.wall_ms << " ms (CPU " << record.cpu_ms
+             << " ms)\n";
+        cout << "Memory: " << record.peak_rss_kb << " KB peak (per test KB:";
+        for (const TestRecord &test : record.tests)
+            cout << ' ' << test.peak_rss_kb;
+        cout << ")\n";
+    }
+    if (record.verdict == "WA")
+        cout << "First difference in "
+             << record.tests[record.failing_test].name << ": line "
+             << record.diff_line << ", byte " << record.diff_offset << '\n';
+    cout << "===================================================\n\n";
+}
+
+ResultLog &resultLog() {
+    static ResultLog log;
+    return log;
+}
@@ -0,0 +1,107 @@
+// result_log.h
+#ifndef RESULT_LOG_H
+#define RESULT_LOG_H
+
+#include <atomic>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+// One test of a judged submission
+struct TestRecord {
+    std::string name;
+    std::string verdict;
+    long wall_ms = 0;
+    long cpu_ms = 0;
+    long peak_rss_kb = 0;
+};
+
+/*
+ * Verdict of one submission. tests holds only the tests a sequential judge
+ * would have run, in the order they were judged ("natural" or "failfast",
+ * see `order`), up to the failing one. failing_test is the index of that
+ * test in `tests` (-1 when AC or CE); diff_line/diff_offset locate the first
+ * wrong byte of a WA.
+ */
+struct ResultRecord {
+    int task_id = 0;
+    std::string problem;
+    std::string verdict;
+    int failing_test = -1;
+    long diff_line = 0;
+    long diff_offset = 0;
+    long wall_ms = 0;
+    long cpu_ms = 0;
+    long peak_rss_kb = 0;
+    size_t judge_id = 0; // judging thread, hashed
+    std::string order = "natural";
+    std::vector<TestRecord> tests;
+};
+
+// The record as one line of JSON (without the newline)
+std::string resultJson(const ResultRecord &record);
+
+/*
+ * Verdicts go through a single writer thread, so banners of concurrent
+ * submissions never interleave and a judging thread never waits on the
+ * terminal or a slow disk.
+ *
+ * log() pushes the record onto a lock-free multi-producer queue and bumps
+ * an eventfd; the writer wakes up, drains the queue, prints a banner per
+ * record to stdout and, with openJsonl(), appends one JSON object per line
+ * to a file that a results consumer can tail.
+ */
+class ResultLog {
+  private:
+    struct Node {
+        std::atomic<Node *> next{nullptr};
+        ResultRecord record;
+    };
+
+    // Producers swing head; only the writer touches tail. tail is a node
+    // whose record has already been taken (initially an empty stub).
+    std::atomic<Node *> head;
+    Node *tail;
+
+    int wake_fd;
+    std::atomic<bool> stop{false};
+    std::thread writer;
+    std::ofstream jsonl;
+    std::function<void(const ResultRecord &)> listener;
+    bool banners = true;
+
+    void writerLoop();
+    bool pop(ResultRecord &record);
+    void print(const ResultRecord &record);
+
+  public:
+    ResultLog();
+    ~ResultLog();
+    ResultLog(const ResultLog &) = delete;
+    ResultLog &operator=(const ResultLog &) = delete;
+
+    // Also write records as JSONL to `path` (truncated); call before the
+    // first log(). False if the file cannot be opened.
+    bool openJsonl(const std::string &path);
+
+    // Also hand every record to `listener`, on the writer thread; call
+    // before the first log()
+    void setListener(std::function<void(const ResultRecord &)> listener);
+
+    // Whether records are printed to stdout (default true)
+    void setBanners(bool on) { banners = on; }
+
+    void log(ResultRecord record);
+
+    // Write everything logged so far and stop the writer; call once no
+    // thread is judging any more. Later records are written by the thread
+    // that logs them.
+    void close();
+};
+
+// The judge's result log
+ResultLog &resultLog();
+
+#endif // RESULT_LOG_H
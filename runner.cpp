@@ -0,0 +1,683 @@
+#include "runner.h"
+#include "forkserver.h"
+#include "metrics.h"
+
+#include <cerrno>  // for errno
+#include <chrono>  // for wall time measurement
+#include <csignal> // for kill, SIGKILL
+#include <cstring> // for memcpy into the SCM_RIGHTS header
+#include <ctime>   // for the child's CPU clock
+#include <fstream> // for the cgroup control files
+#include <thread>  // for sleep_for while a cgroup empties
+#include <vector>  // for the fork server's environment
+
+#include <fcntl.h>        // for open
+#include <sys/stat.h>     // for mkdir on the cgroup tree
+#include <poll.h>         // for poll on the pidfd
+#include <sys/eventfd.h>  // for CancelToken
+#include <sys/resource.h> // for rusage, setrlimit
+#include <sys/socket.h>   // for the fork server's socketpair
+#include <sys/syscall.h>  // for SYS_pidfd_open
+#include <sys/wait.h>     // for wait4
+#include <unistd.h>       // for fork, execv, dup2
+
+using namespace std;
+
+// Bytes read from the output pipe per read() call
+const size_t PIPE_CHUNK = 64 * 1024;
+
+// Shortest sleep between two looks at the child's CPU clock
+const long CPU_POLL_MIN_MS = 5;
+
+// Wall-clock backstop when RunLimits leaves it at 0, as a multiple of the
+// CPU time limit
+const int WALL_LIMIT_FACTOR = 3;
+
+// pidfd_open has no glibc wrapper on older systems, go through syscall()
+static int openPidfd(pid_t pid) {
+#ifdef SYS_pidfd_open
+    return (int)syscall(SYS_pidfd_open, pid, 0);
+#else
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+CancelToken::CancelToken() : fd(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)) {}
+
+CancelToken::~CancelToken() {
+    if (fd >= 0)
+        close(fd);
+}
+
+void CancelToken::cancel() {
+    cancelled = true;
+    if (fd >= 0) {
+        uint64_t one = 1;
+        ssize_t written = write(fd, &one, sizeof(one));
+        (void)written;
+    }
+}
+
+static long toMillis(const timeval &tv) {
+    return tv.tv_sec * 1000L + tv.tv_usec / 1000;
+}
+
+// cgroup v2 directory the runs are placed under, empty when rlimits are used
+static string cgroup_root;
+static atomic<unsigned> cgroup_seq{0};
+
+static bool writeFile(const string &path, const string &value) {
+    ofstream out(path);
+    out << value;
+    out.flush();
+    return (bool)out;
+}
+
+bool useCgroup(const string &dir) {
+    // Hand the memory controller down to the leaves we are going to create
+    writeFile(dir + "/cgroup.subtree_control", "+memory");
+    string probe = dir + "/oj_probe";
+    rmdir(probe.c_str());
+    if (mkdir(probe.c_str(), 0755) != 0)
+        return false;
+    bool ok = writeFile(probe + "/memory.max", "max");
+    rmdir(probe.c_str());
+    if (ok)
+        cgroup_root = dir;
+    return ok;
+}
+
+/*
+ * Leaf cgroup of one run. The child moves itself in by writing "0" to
+ * procs_fd between fork and exec, so it is charged from its first page.
+ */
+struct RunCgroup {
+    string path;
+    int procs_fd = -1;
+
+    // Only when a cgroup root is set and the run has a memory limit
+    bool create(long memory_limit_bytes) {
+        if (cgroup_root.empty() || memory_limit_bytes <= 0)
+            return false;
+        path = cgroup_root + "/run" + to_string(getpid()) + "_" +
+               to_string(cgroup_seq++);
+        if (mkdir(path.c_str(), 0755) != 0)
+            return false;
+        writeFile(path + "/memory.swap.max", "0");
+        procs_fd = writeFile(path + "/memory.max",
+                             to_string(memory_limit_bytes))
+                       ? open((path + "/cgroup.procs").c_str(),
+                              O_WRONLY | O_CLOEXEC)
+                       : -1;
+        if (procs_fd < 0) {
+            rmdir(path.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    // Peak usage in KB and whether the kernel OOM-killed anything inside
+    void readMemory(long &peak_kb, bool &oom_killed) {
+        ifstream peak(path + "/memory.peak"); // Linux 5.19+
+        long long bytes;
+        if (peak >> bytes)
+            peak_kb = max(peak_kb, (long)(bytes / 1024));
+        ifstream events(path + "/memory.events");
+        string key;
+        long long value;
+        while (events >> key >> value)
+            if (key == "oom_kill" && value > 0)
+                oom_killed = true;
+    }
+
+    // The leaf can only be removed once it is empty; descendants the run
+    // left behind were killed with its group but may not be gone yet
+    void destroy() {
+        if (procs_fd < 0)
+            return;
+        close(procs_fd);
+        writeFile(path + "/cgroup.kill", "1");
+        for (int attempt = 0; attempt < 100 && rmdir(path.c_str()) != 0 &&
+                              errno == EBUSY;
+             attempt++)
+            this_thread::sleep_for(chrono::milliseconds(1));
+    }
+};
+
+// execv needs a path; a bare name would not be looked up in cwd
+static string executablePath(const string &executable) {
+    return executable.find('/') == string::npos ? "./" + executable
+                                                : executable;
+}
+
+static long wallLimitOf(const RunLimits &limits) {
+    return limits.wall_limit_ms > 0
+               ? limits.wall_limit_ms
+               : (long)WALL_LIMIT_FACTOR * limits.time_limit_ms;
+}
+
+// RLIMIT_CPU of a run, a safety net for anything the judge misses (e.g. a
+// descendant of the run): SIGXCPU a second past the limit, then SIGKILL
+static long cpuLimitSeconds(const RunLimits &limits) {
+    return limits.time_limit_ms > 0 ? (limits.time_limit_ms + 999) / 1000 + 1
+                                    : 0;
+}
+
+// Fork and exec `path` with the given stdin/stdout. Returns the child's pid
+// (leader of its own process group) or -1.
+static pid_t spawn(const string &path, int in_fd, int out_fd,
+                   const RunLimits &limits, const RunCgroup &cgroup) {
+    char *argv[] = {const_cast<char *>(path.c_str()), nullptr};
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        // Child: only async-signal-safe calls from here on
+        setpgid(0, 0);
+        // The judge may block signals it waits for (daemon mode); the
+        // participant starts with none blocked
+        sigset_t none;
+        sigemptyset(&none);
+        sigprocmask(SIG_SETMASK, &none, nullptr);
+        if (cgroup.procs_fd >= 0) {
+            if (write(cgroup.procs_fd, "0", 1) != 1)
+                _exit(127);
+        } else if (limits.memory_limit_bytes > 0) {
+            rlimit as = {(rlim_t)limits.memory_limit_bytes,
+                         (rlim_t)limits.memory_limit_bytes};
+            setrlimit(RLIMIT_AS, &as);
+        }
+        if (limits.time_limit_ms > 0) {
+            rlim_t seconds = (rlim_t)cpuLimitSeconds(limits);
+            rlimit cpu = {seconds, seconds + 1};
+            setrlimit(RLIMIT_CPU, &cpu);
+        }
+        if (limits.output_limit_bytes > 0) {
+            // Writing past the cap raises SIGXFSZ in the child
+            rlimit fsize = {(rlim_t)limits.output_limit_bytes,
+                            (rlim_t)limits.output_limit_bytes};
+            setrlimit(RLIMIT_FSIZE, &fsize);
+        }
+        if (dup2(in_fd, STDIN_FILENO) < 0 || dup2(out_fd, STDOUT_FILENO) < 0)
+            _exit(127);
+        execv(path.c_str(), argv);
+        _exit(127);
+    }
+    if (pid > 0) {
+        // Also set the group from the parent so kill(-pid) works even if
+        // the child has not been scheduled yet
+        setpgid(pid, pid);
+    }
+    return pid;
+}
+
+ForkServer::ForkServer(const string &executable, const RunLimits &limits) {
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, fds) < 0)
+        return;
+    int null_fd = open("/dev/null", O_RDWR | O_CLOEXEC);
+    if (null_fd < 0) {
+        close(fds[0]);
+        close(fds[1]);
+        return;
+    }
+
+    // Everything the child needs is built before fork
+    string path = executablePath(executable);
+    char *argv[] = {const_cast<char *>(path.c_str()), nullptr};
+    vector<string> env_strings;
+    for (char **entry = environ; *entry; entry++)
+        env_strings.push_back(*entry);
+    env_strings.push_back(string(FORK_SERVER_ENV) + "=" + to_string(fds[1]));
+    vector<char *> envp;
+    for (string &entry : env_strings)
+        envp.push_back(&entry[0]);
+    envp.push_back(nullptr);
+
+    pid = fork();
+    if (pid == 0) {
+        setpgid(0, 0);
+        sigset_t none;
+        sigemptyset(&none);
+        sigprocmask(SIG_SETMASK, &none, nullptr);
+        if (limits.memory_limit_bytes > 0) {
+            rlimit as = {(rlim_t)limits.memory_limit_bytes,
+                         (rlim_t)limits.memory_limit_bytes};
+            setrlimit(RLIMIT_AS, &as);
+        }
+        // Only the shim's end survives exec; the server never reads stdin
+        // or writes stdout itself, the copies get their own
+        if (fcntl(fds[1], F_SETFD, 0) < 0 ||
+            dup2(null_fd, STDIN_FILENO) < 0 || dup2(null_fd, STDOUT_FILENO) < 0)
+            _exit(127);
+        execve(path.c_str(), argv, envp.data());
+        _exit(127);
+    }
+    close(fds[1]);
+    close(null_fd);
+    if (pid < 0) {
+        close(fds[0]);
+        return;
+    }
+    setpgid(pid, pid);
+    control = fds[0];
+
+    // Copies are watched through pidfds only, so the server is useless
+    // without them
+    int pidfd = openPidfd(pid);
+    bool ready = pidfd >= 0;
+    if (ready) {
+        close(pidfd);
+        pollfd pfd = {control, POLLIN, 0};
+        char byte = 0;
+        ready = poll(&pfd, 1, (int)wallLimitOf(limits)) == 1 &&
+                recv(control, &byte, 1, 0) == 1 && byte == FORK_SERVER_READY;
+    }
+    if (!ready)
+        shutdown();
+}
+
+ForkServer::~ForkServer() { shutdown(); }
+
+void ForkServer::shutdown() {
+    if (control >= 0) {
+        close(control);
+        control = -1;
+    }
+    if (pid > 0) {
+        // Idle in recvmsg, or past saving
+        kill(-pid, SIGKILL);
+        while (waitpid(pid, nullptr, 0) < 0 && errno == EINTR) {
+        }
+        pid = -1;
+    }
+}
+
+pid_t ForkServer::start(int in_fd, int out_fd, const RunLimits &limits,
+                        int &pidfd) {
+    pidfd = -1;
+    if (!ok())
+        return -1;
+    ForkRequest request = {limits.memory_limit_bytes, cpuLimitSeconds(limits),
+                           limits.output_limit_bytes};
+    char space[CMSG_SPACE(2 * sizeof(int))] = {};
+    iovec data = {&request, sizeof(request)};
+    msghdr message = {};
+    message.msg_iov = &data;
+    message.msg_iovlen = 1;
+    message.msg_control = space;
+    message.msg_controllen = sizeof(space);
+    cmsghdr *header = CMSG_FIRSTHDR(&message);
+    header->cmsg_level = SOL_SOCKET;
+    header->cmsg_type = SCM_RIGHTS;
+    header->cmsg_len = CMSG_LEN(2 * sizeof(int));
+    int fds[2] = {in_fd, out_fd};
+    memcpy(CMSG_DATA(header), fds, sizeof(fds));
+
+    ForkStarted started = {-1};
+    if (sendmsg(control, &message, MSG_NOSIGNAL) != (ssize_t)sizeof(request) ||
+        recv(control, &started, sizeof(started), 0) !=
+            (ssize_t)sizeof(started)) {
+        shutdown();
+        return -1;
+    }
+    if (started.pid < 0)
+        return -1;
+
+    // The copy stays unreaped until the ack, so the pid is still its own
+    pidfd = openPidfd(started.pid);
+    if (pidfd < 0)
+        kill(-started.pid, SIGKILL);
+    char ack = 1;
+    if (send(control, &ack, 1, MSG_NOSIGNAL) != 1) {
+        shutdown();
+        if (pidfd >= 0)
+            close(pidfd);
+        pidfd = -1;
+        return -1;
+    }
+    if (pidfd < 0) {
+        int status;
+        rusage usage;
+        reap(status, usage);
+        return -1;
+    }
+    return started.pid;
+}
+
+bool ForkServer::reap(int &status, rusage &usage) {
+    ForkFinished finished;
+    ssize_t got;
+    while ((got = recv(control, &finished, sizeof(finished), 0)) < 0 &&
+           errno == EINTR) {
+    }
+    if (got != (ssize_t)sizeof(finished)) {
+        shutdown();
+        return false;
+    }
+    status = finished.status;
+    usage = finished.usage;
+    return true;
+}
+
+enum WaitOutcome { EXITED, TIMED_OUT, CANCELLED, OUTPUT_LIMIT, REJECTED };
+
+// CPU time used so far by the (not yet reaped) child, -1 if unknown
+static long cpuMillisOf(clockid_t clock) {
+    timespec ts;
+    if (clock_gettime(clock, &ts) != 0)
+        return -1;
+    return ts.tv_sec * 1000L + ts.tv_nsec / 1000000;
+}
+
+// Time the child has spent on a CPU or runnable and waiting for one, from
+// /proc/<pid>/schedstat; -1 if unavailable
+static long scheduledMillisOf(pid_t pid) {
+    ifstream in("/proc/" + to_string(pid) + "/schedstat");
+    unsigned long long run_ns, wait_ns;
+    if (!(in >> run_ns >> wait_ns))
+        return -1;
+    return (long)((run_ns + wait_ns) / 1000000);
+}
+
+/*
+ * Block until the child exits (and, when `pipe_fd` >= 0, its output pipe
+ * reaches end of file), it has used `time_limit_ms` of CPU time, it has
+ * spent the wall-clock backstop sleeping or blocked, the run is cancelled,
+ * or the output is rejected or too long. Output read from the pipe is
+ * handed to `on_output`. The child is NOT reaped here. `pidfd`, if not
+ * -1, is one the caller already holds on the child and is closed here.
+ *
+ * Time spent waiting for a CPU does not count towards the backstop, so a
+ * busy host cannot turn a CPU-bound AC into a TLE. Neither clock can be
+ * waited on: while the child runs we wake up when it could have reached a
+ * limit at the earliest.
+ */
+static WaitOutcome waitForExit(pid_t pid, const RunLimits &limits,
+                               chrono::steady_clock::time_point start,
+                               CancelToken *cancel, int pipe_fd,
+                               const OutputSink &on_output,
+                               long &output_bytes, int pidfd) {
+    using namespace chrono;
+    long wall_limit_ms = wallLimitOf(limits);
+    clockid_t cpu_clock;
+    bool have_cpu_clock = clock_getcpuclockid(pid, &cpu_clock) == 0;
+
+    // Without a pidfd fall back to short polls and waitid(WNOWAIT), which
+    // keeps the child reapable by wait4 afterwards
+    if (pidfd < 0)
+        pidfd = openPidfd(pid);
+    int cancel_fd = cancel ? cancel->pollFd() : -1;
+    bool exited = false;
+    char buffer[PIPE_CHUNK];
+
+    while (true) {
+        if (cancel && cancel->isCancelled()) {
+            if (pidfd >= 0)
+                close(pidfd);
+            return CANCELLED;
+        }
+        if (!exited && pidfd < 0) {
+            siginfo_t info = {};
+            exited = waitid(P_PID, pid, &info, WEXITED | WNOHANG | WNOWAIT) ==
+                         0 &&
+                     info.si_pid == pid;
+        }
+        if (exited && pipe_fd < 0)
+            break;
+
+        long wall_ms =
+            duration_cast<milliseconds>(steady_clock::now() - start).count();
+        long scheduled_ms = exited ? -1 : scheduledMillisOf(pid);
+        long blocked_ms =
+            scheduled_ms >= 0 ? max(wall_ms - scheduled_ms, 0L) : wall_ms;
+        long remaining = wall_limit_ms - blocked_ms;
+
+        bool cpu_known = false;
+        long cpu_remaining = 0;
+        if (have_cpu_clock && !exited) {
+            long cpu_ms = cpuMillisOf(cpu_clock);
+            cpu_known = cpu_ms >= 0;
+            cpu_remaining = limits.time_limit_ms - cpu_ms;
+        }
+        if (remaining <= 0 || (cpu_known && cpu_remaining <= 0)) {
+            if (pidfd >= 0)
+                close(pidfd);
+            return TIMED_OUT;
+        }
+
+        pollfd pfds[3];
+        int num_fds = 0, pid_slot = -1, pipe_slot = -1;
+        if (pidfd >= 0 && !exited) {
+            pid_slot = num_fds;
+            pfds[num_fds++] = {pidfd, POLLIN, 0};
+        }
+        if (pipe_fd >= 0) {
+            pipe_slot = num_fds;
+            pfds[num_fds++] = {pipe_fd, POLLIN, 0};
+        }
+        if (cancel_fd >= 0)
+            pfds[num_fds++] = {cancel_fd, POLLIN, 0};
+
+        bool can_block = (pidfd >= 0 || exited) && (!cancel || cancel_fd >= 0);
+        int timeout = can_block ? (int)remaining : 1;
+        if (cpu_known)
+            timeout = (int)min<long>(timeout,
+                                     max(cpu_remaining, CPU_POLL_MIN_MS));
+        if (poll(pfds, num_fds, timeout) < 0 && errno != EINTR)
+            break;
+
+        if (pid_slot >= 0 && (pfds[pid_slot].revents & POLLIN))
+            exited = true;
+
+        if (pipe_slot >= 0 && pfds[pipe_slot].revents) {
+            ssize_t n = read(pipe_fd, buffer, sizeof(buffer));
+            if (n > 0) {
+                output_bytes += n;
+                if (limits.output_limit_bytes > 0 &&
+                    output_bytes > limits.output_limit_bytes) {
+                    if (pidfd >= 0)
+                        close(pidfd);
+                    return OUTPUT_LIMIT;
+                }
+                if (on_output && !on_output(buffer, (size_t)n)) {
+                    if (pidfd >= 0)
+                        close(pidfd);
+                    return REJECTED;
+                }
+            } else if (n == 0 || errno != EINTR) {
+                // End of file: every writer is gone
+                pipe_fd = -1;
+            }
+        }
+    }
+
+    if (pidfd >= 0)
+        close(pidfd);
+    return EXITED;
+}
+
+// Kill the run if needed, reap it (through `server` for a fork-server copy)
+// and fill in the timing and memory fields
+static void finishRun(pid_t pid, WaitOutcome outcome,
+                      chrono::steady_clock::time_point start,
+                      const RunLimits &limits, RunCgroup &cgroup,
+                      ForkServer *server, RunResult &result) {
+    if (outcome != EXITED) {
+        // Time limit exceeded, cancelled or output refused: kill the whole
+        // process group of this run
+        kill(-pid, SIGKILL);
+        countEvent(Counter::PROCESS_KILLS);
+        result.timed_out = outcome == TIMED_OUT;
+        result.cancelled = outcome == CANCELLED;
+        result.output_limit_exceeded = outcome == OUTPUT_LIMIT;
+        result.rejected = outcome == REJECTED;
+    }
+
+    int status = 0;
+    rusage usage = {};
+    if (server) {
+        if (!server->reap(status, usage))
+            result.error = true;
+    } else {
+        while (wait4(pid, &status, 0, &usage) < 0 && errno == EINTR) {
+        }
+    }
+    auto end = chrono::steady_clock::now();
+
+    result.exit_status = status;
+    result.wall_ms =
+        chrono::duration_cast<chrono::milliseconds>(end - start).count();
+    result.cpu_ms = toMillis(usage.ru_utime) + toMillis(usage.ru_stime);
+    result.peak_rss_kb = usage.ru_maxrss; // KB on Linux
+    if (WIFSIGNALED(status) && WTERMSIG(status) == SIGXFSZ)
+        result.output_limit_exceeded = true;
+
+    // The verdict goes by CPU time: a run that finished between two looks
+    // at its clock, or that RLIMIT_CPU stopped, is over the limit too
+    if (!result.cancelled &&
+        (result.cpu_ms > limits.time_limit_ms ||
+         (WIFSIGNALED(status) && WTERMSIG(status) == SIGXCPU)))
+        result.timed_out = true;
+
+    if (limits.memory_limit_bytes <= 0)
+        return;
+    bool over = result.peak_rss_kb * 1024L > limits.memory_limit_bytes;
+    if (cgroup.procs_fd >= 0) {
+        cgroup.readMemory(result.peak_rss_kb, over);
+    } else if (WIFSIGNALED(status)) {
+        // Under RLIMIT_AS an allocation fails instead of growing the RSS:
+        // in C++ that is an uncaught std::bad_alloc, i.e. abort(), and an
+        // unchecked malloc() crashes once the memory is nearly used up. A
+        // growing container fails while holding over a third of the limit
+        // (old buffer plus one twice its size), so an abort() below that,
+        // like a failed assert(), is a crash and not the limit.
+        int sig = WTERMSIG(status);
+        long peak_bytes = result.peak_rss_kb * 1024L;
+        if ((sig == SIGABRT && peak_bytes * 3 >= limits.memory_limit_bytes) ||
+            (sig == SIGSEGV &&
+             peak_bytes * 10 >= limits.memory_limit_bytes * 9))
+            over = true;
+    }
+    if (over && !result.timed_out && !result.cancelled)
+        result.memory_limit_exceeded = true;
+}
+
+RunResult runProcess(const string &executable, int in_fd, int out_fd,
+                     const RunLimits &limits, CancelToken *cancel,
+                     ForkServer *server) {
+    RunResult result;
+    if (cancel && cancel->isCancelled()) {
+        result.cancelled = true;
+        return result;
+    }
+
+    if (server && !server->ok())
+        server = nullptr;
+    RunCgroup cgroup;
+    if (!server)
+        cgroup.create(limits.memory_limit_bytes);
+
+    auto start = chrono::steady_clock::now();
+    int pidfd = -1;
+    pid_t pid =
+        server ? server->start(in_fd, out_fd, limits, pidfd)
+               : spawn(executablePath(executable), in_fd, out_fd, limits,
+                       cgroup);
+    if (pid < 0) {
+        cgroup.destroy();
+        result.error = true;
+        return result;
+    }
+
+    long output_bytes = 0;
+    WaitOutcome outcome = waitForExit(pid, limits, start, cancel, -1,
+                                      nullptr, output_bytes, pidfd);
+    finishRun(pid, outcome, start, limits, cgroup, server, result);
+    cgroup.destroy();
+    return result;
+}
+
+RunResult runProcess(const string &executable, const string &input_file,
+                     const string &output_file, const RunLimits &limits,
+                     CancelToken *cancel, ForkServer *server) {
+    int in_fd = open(input_file.c_str(), O_RDONLY | O_CLOEXEC);
+    int out_fd = open(output_file.c_str(),
+                      O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    RunResult result;
+    if (in_fd >= 0 && out_fd >= 0)
+        result = runProcess(executable, in_fd, out_fd, limits, cancel, server);
+    else
+        result.error = true;
+    if (in_fd >= 0)
+        close(in_fd);
+    if (out_fd >= 0)
+        close(out_fd);
+    return result;
+}
+
+RunResult runProcessStreaming(const string &executable, int in_fd,
+                              const RunLimits &limits,
+                              const OutputSink &on_output,
+                              CancelToken *cancel, ForkServer *server) {
+    RunResult result;
+    if (cancel && cancel->isCancelled()) {
+        result.cancelled = true;
+        return result;
+    }
+
+    int pipe_fds[2];
+    if (pipe2(pipe_fds, O_CLOEXEC) < 0) {
+        result.error = true;
+        return result;
+    }
+
+    // The cap is enforced on the pipe by the reader, RLIMIT_FSIZE does not
+    // apply to pipes
+    RunLimits child_limits = limits;
+    child_limits.output_limit_bytes = 0;
+
+    if (server && !server->ok())
+        server = nullptr;
+    RunCgroup cgroup;
+    if (!server)
+        cgroup.create(limits.memory_limit_bytes);
+
+    auto start = chrono::steady_clock::now();
+    int pidfd = -1;
+    pid_t pid = server ? server->start(in_fd, pipe_fds[1], child_limits, pidfd)
+                       : spawn(executablePath(executable), in_fd,
+                               pipe_fds[1], child_limits, cgroup);
+    close(pipe_fds[1]);
+    if (pid < 0) {
+        close(pipe_fds[0]);
+        cgroup.destroy();
+        result.error = true;
+        return result;
+    }
+
+    WaitOutcome outcome =
+        waitForExit(pid, limits, start, cancel, pipe_fds[0], on_output,
+                    result.output_bytes, pidfd);
+    close(pipe_fds[0]);
+    finishRun(pid, outcome, start, limits, cgroup, server, result);
+    cgroup.destroy();
+    return result;
+}
+
+RunResult runProcessStreaming(const string &executable,
+                              const string &input_file,
+                              const RunLimits &limits,
+                              const OutputSink &on_output,
+                              CancelToken *cancel, ForkServer *server) {
+    int in_fd = open(input_file.c_str(), O_RDONLY | O_CLOEXEC);
+    if (in_fd < 0) {
+        RunResult result;
+        result.error = true;
+        return result;
+    }
+    RunResult result = runProcessStreaming(executable, in_fd, limits,
+                                           on_output, cancel, server);
+    close(in_fd);
+    return result;
+}
@@ -0,0 +1,166 @@
+// runner.h
+#ifndef RUNNER_H
+#define RUNNER_H
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <string>
+
+#include <sys/types.h> // for pid_t
+
+struct rusage;
+
+/*
+ * Outcome of one participant run:
+ *      timed_out   - the run used more CPU time than its limit, or hit the
+ *                    wall-clock backstop, and the process group was killed
+ *      cancelled   - the run was cancelled through its CancelToken and the
+ *                    process group was killed (or never started)
+ *      output_limit_exceeded - the output grew past the cap
+ *      memory_limit_exceeded - the run was OOM-killed in its cgroup, peaked
+ *                    above the memory limit, or, under the address-space
+ *                    rlimit, aborted (uncaught std::bad_alloc) or crashed
+ *                    within 10% of the limit
+ *      rejected    - the output consumer refused the output (streaming only)
+ *      exit_status - raw status from wait4 (use WIFEXITED & co. on it)
+ *      wall_ms     - wall time from fork to reap, in milliseconds
+ *      cpu_ms      - user + system CPU time of the child, from rusage
+ *      peak_rss_kb - peak resident set size of the child, from rusage (or
+ *                    the cgroup's memory.peak when that is higher)
+ *      output_bytes - bytes read from the output pipe (streaming only)
+ *      error       - the run could not be started (bad input/output file,
+ *                    fork failure); the other fields are meaningless
+ */
+struct RunResult {
+    bool timed_out = false;
+    bool cancelled = false;
+    bool output_limit_exceeded = false;
+    bool memory_limit_exceeded = false;
+    bool rejected = false;
+    int exit_status = 0;
+    long wall_ms = 0;
+    long cpu_ms = 0;
+    long peak_rss_kb = 0;
+    long output_bytes = 0;
+    bool error = false;
+};
+
+/*
+ * Limits of one run:
+ *      time_limit_ms      - CPU time (user + system) before the run is killed
+ *                           as a TLE; the verdict does not depend on load
+ *      wall_limit_ms      - backstop for runs that sleep or block: wall time
+ *                           spent neither on a CPU nor waiting for one, 0
+ *                           for 3x time_limit_ms
+ *      output_limit_bytes - largest allowed output, 0 for no limit
+ *      memory_limit_bytes - memory of the run, 0 for no limit. Enforced by a
+ *                           cgroup v2 leaf when useCgroup() succeeded, else
+ *                           by RLIMIT_AS on the child.
+ */
+struct RunLimits {
+    int time_limit_ms = 2000;
+    int wall_limit_ms = 0;
+    long output_limit_bytes = 0;
+    long memory_limit_bytes = 0;
+};
+
+// Receives the output of a streaming run as it arrives; returning false
+// kills the run
+typedef std::function<bool(const char *data, size_t size)> OutputSink;
+
+/*
+ * Lets another thread abort a run. cancel() wakes the waiting runner
+ * immediately through an eventfd, so no polling is involved.
+ */
+class CancelToken {
+  private:
+    int fd;
+    std::atomic<bool> cancelled{false};
+
+  public:
+    CancelToken();
+    ~CancelToken();
+    CancelToken(const CancelToken &) = delete;
+    CancelToken &operator=(const CancelToken &) = delete;
+
+    void cancel();
+    bool isCancelled() const { return cancelled; }
+    // Readable once cancel() has been called, -1 if eventfd is unavailable
+    int pollFd() const { return fd; }
+};
+
+// Place every following run in its own cgroup v2 leaf under `dir`, with
+// memory.max set to its memory limit and swap disabled. `dir` must be a
+// delegated cgroup v2 directory we may create children in. Returns false
+// (and runs keep using rlimits) if the memory controller is not available
+// there.
+bool useCgroup(const std::string &dir);
+
+/*
+ * A participant binary linked with the fork-server shim (forkserver.h),
+ * started once with `limits` and parked before main(). A run given the
+ * server forks a copy of the initialized process instead of exec'ing the
+ * binary again, so dynamic loading and static initialization are paid once
+ * per submission rather than once per test. Memory is limited by RLIMIT_AS
+ * even when useCgroup() is on.
+ *
+ * ok() is false when the binary did not come up as a fork server (built
+ * without the shim, crashed, or still initializing after the wall-clock
+ * backstop); runs then go to the executable directly. A server takes one
+ * run at a time.
+ */
+class ForkServer {
+  private:
+    pid_t pid = -1;
+    int control = -1;
+
+    void shutdown();
+
+  public:
+    ForkServer(const std::string &executable, const RunLimits &limits);
+    ~ForkServer();
+    ForkServer(const ForkServer &) = delete;
+    ForkServer &operator=(const ForkServer &) = delete;
+
+    bool ok() const { return control >= 0; }
+    // Fork a copy reading `in_fd` and writing `out_fd`. Returns its pid and
+    // a pidfd on it in `pidfd`, or -1.
+    pid_t start(int in_fd, int out_fd, const RunLimits &limits, int &pidfd);
+    // Collect the copy started last once the server has reaped it. False
+    // if the server is gone, which also makes it !ok().
+    bool reap(int &status, rusage &usage);
+};
+
+// Run `executable` directly (no shell) with stdin read from `input_file` and
+// stdout written to `output_file`. The child is placed in its own process
+// group so a TLE or a cancel kills it together with anything it spawned.
+RunResult runProcess(const std::string &executable,
+                     const std::string &input_file,
+                     const std::string &output_file, const RunLimits &limits,
+                     CancelToken *cancel = nullptr,
+                     ForkServer *server = nullptr);
+
+// Like runProcess, but stdout is a pipe read by the judge and handed to
+// `on_output` as it arrives, so nothing is written to disk and the run can
+// be stopped at the first wrong byte. With a `server` that is ok(), both
+// run a fork of it instead of `executable`.
+RunResult runProcessStreaming(const std::string &executable,
+                              const std::string &input_file,
+                              const RunLimits &limits,
+                              const OutputSink &on_output,
+                              CancelToken *cancel = nullptr,
+                              ForkServer *server = nullptr);
+
+// The same two with stdin (and stdout) given as descriptors, e.g. memfds.
+// They are duplicated into the child and left open for the caller.
+RunResult runProcess(const std::string &executable, int in_fd, int out_fd,
+                     const RunLimits &limits, CancelToken *cancel = nullptr,
+                     ForkServer *server = nullptr);
+RunResult runProcessStreaming(const std::string &executable, int in_fd,
+                              const RunLimits &limits,
+                              const OutputSink &on_output,
+                              CancelToken *cancel = nullptr,
+                              ForkServer *server = nullptr);
+
+#endif // RUNNER_H
@@ -0,0 +1,213 @@
+#include "simulator.h"
+#include "cost_model.h"
+#include "problems.h"
+#include "stats.h"
+#include "test_stats.h"
+
+#include <algorithm> // for stable_sort
+#include <cmath>     // for log
+#include <fstream>
+#include <iomanip> // for setw, setprecision
+#include <limits>
+#include <map>
+#include <numeric> // for iota
+#include <ostream>
+#include <queue>   // for priority_queue
+#include <random>
+#include <utility>
+
+using namespace std;
+
+bool readRequestFile(const string &path, vector<SimJob> &jobs,
+                     int &num_threads) {
+    ifstream in(path);
+    int num_tasks = 0;
+    if (!(in >> num_tasks >> num_threads))
+        return false;
+    jobs.clear();
+    for (int i = 0; i < num_tasks; i++) {
+        SimJob job;
+        string code;
+        if (!(in >> job.arrival_ms >> job.problem >> code))
+            break;
+        job.source = "Submit/" + code + ".cpp";
+        jobs.push_back(job);
+    }
+    return true;
+}
+
+string compileCostKey(const string &source) { return "compile:" + source; }
+
+string runCostKey(const string &problem, const string &source) {
+    return "run:" + problem + ":" + source;
+}
+
+static const char *policyName(SchedulePolicy policy) {
+    switch (policy) {
+    case SchedulePolicy::SJF:
+        return "sjf";
+    case SchedulePolicy::FAIR:
+        return "fair";
+    default:
+        return "fifo";
+    }
+}
+
+Simulator::Simulator(const vector<SimJob> &jobs, const SimModel &model,
+                     const CostModel &costs, const TestStats &stats)
+    : jobs(jobs) {
+    mt19937 rng(model.seed);
+    // Lognormal with the given mean: mu = ln(mean) - sigma^2 / 2
+    auto sample = [&](double mean_ms) {
+        lognormal_distribution<double> duration(
+            log(max(mean_ms, 0.001)) - model.spread * model.spread / 2,
+            model.spread);
+        return duration(rng);
+    };
+
+    for (const SimJob &job : jobs) {
+        bool recorded = false;
+        double compile = 0, run = 0;
+        if (model.recorded) {
+            compile = costs.expected(compileCostKey(job.source));
+            run = costs.expected(runCostKey(job.problem, job.source));
+            recorded = compile > 0 && run > 0;
+        }
+        if (compile <= 0)
+            compile = sample(model.compile_ms);
+        if (run <= 0) {
+            // Sum of the tests: their recorded means, sampled where missing
+            // (an unknown problem is judged as one test)
+            shared_ptr<const Problem> problem =
+                problemRegistry().get(job.problem);
+            size_t tests = problem ? problem->tests.size() : 1;
+            run = 0;
+            for (size_t k = 0; k < tests; k++) {
+                double mean = -1;
+                if (model.recorded && problem)
+                    mean = stats.meanCpuMs(job.problem, problem->tests[k].name);
+                run += mean >= 0 ? mean : sample(model.test_ms);
+            }
+        }
+        compile_ms.push_back(compile);
+        run_ms.push_back(run);
+        // What the real pool would estimate for SJF
+        expected_ms.push_back(
+            costs.expected(job.problem + ":" + job.source, job.problem));
+        if (recorded)
+            recorded_jobs++;
+    }
+}
+
+SimResult Simulator::run(int threads, SchedulePolicy policy) const {
+    SimResult result;
+    result.threads = threads = max(1, threads);
+    result.policy = policy;
+    size_t n = jobs.size();
+    result.times.resize(n);
+    if (n == 0)
+        return result;
+
+    // Submission order, which is also the pool's sequence number
+    vector<size_t> arrivals(n);
+    iota(arrivals.begin(), arrivals.end(), 0);
+    stable_sort(arrivals.begin(), arrivals.end(), [&](size_t a, size_t b) {
+        return jobs[a].arrival_ms < jobs[b].arrival_ms;
+    });
+    vector<uint64_t> seq(n);
+    for (size_t k = 0; k < n; k++)
+        seq[arrivals[k]] = k;
+
+    // Virtual milliseconds as the load report's time points
+    auto at = [](double ms) {
+        return SubmissionTimes::clock::time_point(
+            chrono::duration_cast<SubmissionTimes::clock::duration>(
+                chrono::duration<double, milli>(ms)));
+    };
+
+    typedef pair<double, size_t> Finish; // time, job
+    priority_queue<Finish, vector<Finish>, greater<Finish>> running;
+    vector<size_t> queued;
+    map<string, double> served;
+    int idle = threads;
+    size_t next = 0;
+    double busy_ms = 0;
+    const double never = numeric_limits<double>::infinity();
+
+    while (next < n || !running.empty()) {
+        // Advance to the next event: a worker finishing or a submission
+        // arriving; finishes first, so a freed worker can take the arrival
+        double now = min(next < n ? jobs[arrivals[next]].arrival_ms : never,
+                         running.empty() ? never : running.top().first);
+        while (!running.empty() && running.top().first <= now) {
+            size_t j = running.top().second;
+            running.pop();
+            idle++;
+            if (policy == SchedulePolicy::FAIR)
+                served[jobs[j].problem] +=
+                    compile_ms[j] + run_ms[j] - expected_ms[j];
+        }
+        while (next < n && jobs[arrivals[next]].arrival_ms <= now)
+            queued.push_back(arrivals[next++]);
+
+        for (; idle > 0 && !queued.empty(); idle--) {
+            size_t best = 0;
+            pair<double, uint64_t> best_score;
+            for (size_t k = 0; k < queued.size(); k++) {
+                size_t j = queued[k];
+                auto score = schedulingScore(policy, expected_ms[j], seq[j],
+                                             jobs[j].problem, served);
+                if (k == 0 || score < best_score) {
+                    best = k;
+                    best_score = score;
+                }
+            }
+            size_t j = queued[best];
+            queued.erase(queued.begin() + best);
+            // Charged up front, corrected when it finishes, as the pool does
+            if (policy == SchedulePolicy::FAIR)
+                served[jobs[j].problem] += expected_ms[j];
+
+            double finish = now + compile_ms[j] + run_ms[j];
+            SubmissionTimes &t = result.times[j];
+            t.submitted = at(jobs[j].arrival_ms);
+            t.compile_start = at(now);
+            t.compile_end = t.run_start = at(now + compile_ms[j]);
+            t.done = at(finish);
+            t.compiled = true;
+            busy_ms += finish - now;
+            result.makespan_ms = max(result.makespan_ms, finish);
+            running.push({finish, j});
+        }
+    }
+
+    if (result.makespan_ms > 0)
+        result.utilization = busy_ms / (threads * result.makespan_ms);
+    return result;
+}
+
+void printSimTable(ostream &out, const vector<SimResult> &results) {
+    out << fixed << setprecision(1);
+    out << setw(8) << "threads" << setw(8) << "policy" << setw(12)
+        << "makespan" << setw(8) << "util%" << setw(10) << "wait p50"
+        << setw(10) << "lat p50" << setw(10) << "lat p90" << setw(10)
+        << "lat p99" << setw(10) << "lat max" << '\n';
+    for (const SimResult &r : results) {
+        vector<double> wait_ms, latency_ms;
+        for (const SubmissionTimes &t : r.times) {
+            wait_ms.push_back(
+                chrono::duration<double, milli>(t.compile_start - t.submitted)
+                    .count());
+            latency_ms.push_back(
+                chrono::duration<double, milli>(t.done - t.submitted).count());
+        }
+        out << setw(8) << r.threads << setw(8) << policyName(r.policy)
+            << setw(12) << r.makespan_ms << setw(8) << 100 * r.utilization
+            << setw(10) << percentile(wait_ms, 50) << setw(10)
+            << percentile(latency_ms, 50) << setw(10)
+            << percentile(latency_ms, 90) << setw(10)
+            << percentile(latency_ms, 99) << setw(10)
+            << percentile(latency_ms, 100) << '\n';
+    }
+    out << defaultfloat;
+}
@@ -0,0 +1,93 @@
+// simulator.h
+#ifndef SIMULATOR_H
+#define SIMULATOR_H
+
+#include "load_report.h"
+#include "thread_pool.h"
+
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+class CostModel;
+class TestStats;
+
+// One submission of a request file: when it arrives, for which problem and
+// from which source ("Submit/<code>.cpp")
+struct SimJob {
+    double arrival_ms = 0;
+    std::string problem;
+    std::string source;
+};
+
+// Read "Test/<name>.txt": "<tasks> <threads>" then "<ms> <problem> <code>"
+// per submission. Returns false when the file cannot be read.
+bool readRequestFile(const std::string &path, std::vector<SimJob> &jobs,
+                     int &num_threads);
+
+/*
+ * Where the simulated durations come from:
+ *      recorded     - use the profiles kept by earlier runs where they
+ *                     exist (the compile and run time of the source, else
+ *                     the mean CPU time of the problem's tests), and the
+ *                     distributions below for the rest
+ *      compile_ms   - mean compile time when there is no profile
+ *      test_ms      - mean time of one test when there is no profile
+ *      spread       - sigma of the lognormal the sampled durations follow
+ *      seed         - of the sampling, so that runs are reproducible
+ */
+struct SimModel {
+    bool recorded = true;
+    double compile_ms = 400;
+    double test_ms = 20;
+    double spread = 0.5;
+    unsigned seed = 1;
+};
+
+// The predicted outcome of one configuration
+struct SimResult {
+    int threads = 0;
+    SchedulePolicy policy = SchedulePolicy::FIFO;
+    double makespan_ms = 0;   // first arrival at 0 to the last verdict
+    double utilization = 0;   // busy fraction of the workers (0..1)
+    std::vector<SubmissionTimes> times; // in virtual time, from 0
+};
+
+/*
+ * Discrete-event replay of a request file in virtual time, to see what a
+ * pool size or scheduling policy would do to a workload without running it.
+ *
+ * Every job's compile and run durations are fixed once, in the constructor,
+ * so all configurations replay the same workload. run() then models the
+ * thread pool: `threads` workers taking submissions from one queue in the
+ * order schedulingScore() gives, with SJF estimates read from the same
+ * CostModel the real pool uses and FAIR charging each group as the pool
+ * does. A submission holds its worker through the compile and the run, as
+ * in the default (non-pipeline) mode.
+ */
+class Simulator {
+  private:
+    std::vector<SimJob> jobs;
+    std::vector<double> compile_ms, run_ms; // per job
+    std::vector<double> expected_ms;        // SJF estimate per job
+    size_t recorded_jobs = 0;
+
+  public:
+    Simulator(const std::vector<SimJob> &jobs, const SimModel &model,
+              const CostModel &costs, const TestStats &stats);
+
+    SimResult run(int threads, SchedulePolicy policy) const;
+
+    // Jobs whose durations all came from profiles
+    size_t recordedJobs() const { return recorded_jobs; }
+};
+
+// Cost-model keys under which the judge records each stage of a submission
+std::string compileCostKey(const std::string &source);
+std::string runCostKey(const std::string &problem, const std::string &source);
+
+// One line per result: pool size, policy, makespan, utilization, latency
+// percentiles
+void printSimTable(std::ostream &out, const std::vector<SimResult> &results);
+
+#endif // SIMULATOR_H
@@ -0,0 +1,303 @@
+#include "special_checker.h"
+#include "compile_cache.h"
+#include "hashing.h"
+#include "input_store.h"
+#include "oj_checker.h"
+
+#include <cerrno>
+#include <csignal> // for kill, SIGKILL
+#include <cstring> // for memcpy into the SCM_RIGHTS header
+#include <filesystem>
+#include <fstream>
+#include <iterator> // for istreambuf_iterator
+#include <map>
+#include <utility>
+
+#include <dlfcn.h>        // for dlopen
+#include <fcntl.h>        // for open
+#include <poll.h>         // for the check timeout
+#include <sys/resource.h> // for the host's memory limit
+#include <sys/socket.h>   // for the host's socketpair
+#include <sys/wait.h>     // for waitpid
+#include <unistd.h>       // for fork, execv
+
+using namespace std;
+namespace fs = std::filesystem;
+
+const string CHECKER_DIR = ".oj_cache/checkers";
+const string CHECKER_HEADER = "oj_checker.h";
+const string CHECKER_FLAGS = "-std=c++17 -O2 -shared -fPIC -I.";
+const char *CHECKER_SYMBOL = "oj_check";
+
+// Longest an isolated check, or a host's start, may take
+const int CHECKER_TIMEOUT_MS = 10000;
+// Address space of a checker host
+const rlim_t CHECKER_HOST_MEMORY_BYTES = 1ul << 30; // 1 GB
+
+// First byte a host sends once it has loaded the checker
+const char CHECKER_HOST_READY = 'R';
+
+typedef int (*CheckFunction)(const char *, size_t, const char *, size_t,
+                             const char *, size_t);
+
+static string readFile(const string &path) {
+    ifstream in(path, ios::binary);
+    return string((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+}
+
+string buildChecker(const string &source) {
+    string code = readFile(source);
+    if (code.empty())
+        return "";
+    // Like the fork-server shim: one object per (compiler, source, API)
+    string key = toHex(fnv1a(compilerVersion() + '\0' + code + '\0' +
+                             readFile(CHECKER_HEADER)));
+    fs::path object = fs::path(CHECKER_DIR) / (key + ".so");
+
+    error_code ec;
+    if (fs::exists(object, ec))
+        return object.string();
+    fs::create_directories(CHECKER_DIR, ec);
+    fs::path tmp = object.string() + "." + to_string(getpid()) + ".tmp";
+    if (!runCompiler(CHECKER_FLAGS, {source, "-o", tmp.string()})) {
+        fs::remove(tmp, ec);
+        return "";
+    }
+    fs::rename(tmp, object, ec);
+    return ec ? "" : object.string();
+}
+
+static CheckFunction loadChecker(const string &object, void *&handle) {
+    // A relative name would be searched for on the library path
+    string path = fs::absolute(object).string();
+    handle = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+    if (!handle)
+        return nullptr;
+    auto function = (CheckFunction)dlsym(handle, CHECKER_SYMBOL);
+    if (!function) {
+        dlclose(handle);
+        handle = nullptr;
+    }
+    return function;
+}
+
+// Run the checker on three mapped files; IE when one cannot be mapped
+static CompareResult callChecker(CheckFunction function, const string &input,
+                                 const string &output, const string &answer) {
+    CompareResult result;
+    MappedFile in(input), out(output), ans(answer);
+    if (!in.ok || !out.ok || !ans.ok) {
+        result.error = true;
+        return result;
+    }
+    int verdict =
+        function(in.data, in.size, out.data, out.size, ans.data, ans.size);
+    result.equal = verdict == OJ_ACCEPTED;
+    result.error = verdict != OJ_ACCEPTED && verdict != OJ_WRONG_ANSWER;
+    return result;
+}
+
+SpecialChecker::SpecialChecker(const string &object, bool isolated)
+    : object(object), isolated(isolated) {
+    if (!isolated)
+        check_function = loadChecker(object, handle);
+}
+
+SpecialChecker::~SpecialChecker() {
+    {
+        lock_guard<mutex> lock(host_mutex);
+        for (Host &host : idle_hosts)
+            stopHost(host);
+    }
+    if (handle)
+        dlclose(handle);
+}
+
+bool SpecialChecker::ok() const {
+    return isolated ? !object.empty() : check_function != nullptr;
+}
+
+bool SpecialChecker::startHost(Host &host) {
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, fds) != 0)
+        return false;
+    // Built before fork: the child may only exec
+    string self = "/proc/self/exe", mode = "--checker-host";
+    string fd = to_string(fds[1]);
+    char *argv[] = {&self[0], &mode[0], &object[0], &fd[0], nullptr};
+
+    host.pid = fork();
+    if (host.pid == 0) {
+        setpgid(0, 0);
+        sigset_t none;
+        sigemptyset(&none);
+        sigprocmask(SIG_SETMASK, &none, nullptr);
+        rlimit as = {CHECKER_HOST_MEMORY_BYTES, CHECKER_HOST_MEMORY_BYTES};
+        setrlimit(RLIMIT_AS, &as);
+        if (fcntl(fds[1], F_SETFD, 0) < 0)
+            _exit(127);
+        execv(self.c_str(), argv);
+        _exit(127);
+    }
+    close(fds[1]);
+    if (host.pid < 0) {
+        close(fds[0]);
+        return false;
+    }
+    setpgid(host.pid, host.pid);
+    host.control = fds[0];
+
+    pollfd pfd = {host.control, POLLIN, 0};
+    char byte = 0;
+    if (poll(&pfd, 1, CHECKER_TIMEOUT_MS) == 1 &&
+        recv(host.control, &byte, 1, 0) == 1 && byte == CHECKER_HOST_READY)
+        return true;
+    stopHost(host);
+    return false;
+}
+
+void SpecialChecker::stopHost(Host &host) {
+    if (host.control >= 0) {
+        close(host.control);
+        host.control = -1;
+    }
+    if (host.pid > 0) {
+        kill(-host.pid, SIGKILL);
+        while (waitpid(host.pid, nullptr, 0) < 0 && errno == EINTR) {
+        }
+        host.pid = -1;
+    }
+}
+
+CompareResult SpecialChecker::check(const string &input_file,
+                                    const string &output_file,
+                                    const string &answer_file) {
+    if (!isolated) {
+        if (check_function)
+            return callChecker(check_function, input_file, output_file,
+                               answer_file);
+        CompareResult failed;
+        failed.error = true;
+        return failed;
+    }
+
+    CompareResult result;
+    result.error = true;
+    int fds[3];
+    const string *paths[3] = {&input_file, &output_file, &answer_file};
+    for (int k = 0; k < 3; k++)
+        fds[k] = open(paths[k]->c_str(), O_RDONLY | O_CLOEXEC);
+    bool opened = fds[0] >= 0 && fds[1] >= 0 && fds[2] >= 0;
+
+    // Another check may run on another host meanwhile
+    Host host;
+    if (opened) {
+        lock_guard<mutex> lock(host_mutex);
+        if (!idle_hosts.empty()) {
+            host = idle_hosts.back();
+            idle_hosts.pop_back();
+        }
+    }
+    if (opened && (host.control >= 0 || startHost(host))) {
+        char request = 1;
+        char space[CMSG_SPACE(sizeof(fds))] = {};
+        iovec data = {&request, sizeof(request)};
+        msghdr message = {};
+        message.msg_iov = &data;
+        message.msg_iovlen = 1;
+        message.msg_control = space;
+        message.msg_controllen = sizeof(space);
+        cmsghdr *header = CMSG_FIRSTHDR(&message);
+        header->cmsg_level = SOL_SOCKET;
+        header->cmsg_type = SCM_RIGHTS;
+        header->cmsg_len = CMSG_LEN(sizeof(fds));
+        memcpy(CMSG_DATA(header), fds, sizeof(fds));
+
+        pollfd pfd = {host.control, POLLIN, 0};
+        int verdict = -1;
+        if (sendmsg(host.control, &message, MSG_NOSIGNAL) == 1 &&
+            poll(&pfd, 1, CHECKER_TIMEOUT_MS) == 1 &&
+            recv(host.control, &verdict, sizeof(verdict), 0) ==
+                (ssize_t)sizeof(verdict)) {
+            result.equal = verdict == OJ_ACCEPTED;
+            result.error =
+                verdict != OJ_ACCEPTED && verdict != OJ_WRONG_ANSWER;
+            lock_guard<mutex> lock(host_mutex);
+            idle_hosts.push_back(host);
+        } else {
+            // Crashed or hung: a later check starts a fresh host
+            stopHost(host);
+        }
+    }
+    for (int fd : fds)
+        if (fd >= 0)
+            close(fd);
+    return result;
+}
+
+shared_ptr<SpecialChecker> specialChecker(const string &source,
+                                          uint64_t source_hash,
+                                          bool isolated) {
+    static mutex checkers_mutex;
+    static map<pair<string, bool>, shared_ptr<SpecialChecker>> checkers;
+
+    // Keyed by content as well, so an edited checker is built again
+    pair<string, bool> key = {toHex(source_hash) + ' ' + source, isolated};
+    lock_guard<mutex> lock(checkers_mutex);
+    auto it = checkers.find(key);
+    if (it != checkers.end())
+        return it->second;
+
+    shared_ptr<SpecialChecker> checker;
+    string object = buildChecker(source);
+    if (!object.empty()) {
+        checker = make_shared<SpecialChecker>(object, isolated);
+        if (!checker->ok())
+            checker.reset();
+    }
+    checkers[key] = checker;
+    return checker;
+}
+
+int runCheckerHost(const string &object, int fd) {
+    void *handle = nullptr;
+    CheckFunction function = loadChecker(object, handle);
+    if (!function)
+        return 1;
+    if (send(fd, &CHECKER_HOST_READY, 1, MSG_NOSIGNAL) != 1)
+        return 1;
+
+    while (true) {
+        char request = 0;
+        int fds[3] = {-1, -1, -1};
+        char space[CMSG_SPACE(sizeof(fds))] = {};
+        iovec data = {&request, sizeof(request)};
+        msghdr message = {};
+        message.msg_iov = &data;
+        message.msg_iovlen = 1;
+        message.msg_control = space;
+        message.msg_controllen = sizeof(space);
+        ssize_t got = recvmsg(fd, &message, MSG_CMSG_CLOEXEC);
+        if (got < 0 && errno == EINTR)
+            continue;
+        if (got <= 0)
+            return 0; // the judge is gone
+        cmsghdr *header = CMSG_FIRSTHDR(&message);
+        if (header && header->cmsg_type == SCM_RIGHTS &&
+            header->cmsg_len == CMSG_LEN(sizeof(fds)))
+            memcpy(fds, CMSG_DATA(header), sizeof(fds));
+
+        CompareResult result = callChecker(function, memfdPath(fds[0]),
+                                           memfdPath(fds[1]),
+                                           memfdPath(fds[2]));
+        for (int k : fds)
+            if (k >= 0)
+                close(k);
+        int verdict = result.equal ? OJ_ACCEPTED : OJ_WRONG_ANSWER;
+        if (result.error)
+            verdict = -1;
+        if (send(fd, &verdict, sizeof(verdict), MSG_NOSIGNAL) !=
+            (ssize_t)sizeof(verdict))
+            return 0;
+    }
+}
@@ -0,0 +1,82 @@
+// special_checker.h
+#ifndef SPECIAL_CHECKER_H
+#define SPECIAL_CHECKER_H
+
+#include "checker.h"
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <sys/types.h> // for pid_t
+
+/*
+ * A problem's own checker (oj_checker.h), compiled once into a shared
+ * object under .oj_cache/checkers/.
+ *
+ * In process (the default) the object is dlopen'ed into the judge and
+ * oj_check() is called directly on mapped files, so checking costs no
+ * process at all. Isolated, the object is loaded by checker hosts,
+ * `OJ --checker-host` processes kept for later checks: each check takes an
+ * idle host (or starts one, so there are as many as checks ever ran at
+ * once), sends it read-only descriptors of the three files and waits for
+ * the answer, up to CHECKER_TIMEOUT_MS, then hands the host back. A host
+ * that crashes or hangs is killed and that check is an internal error. The
+ * hosts only guard the judge against crashes, hangs and memory blow-ups of
+ * the checker; they are not a sandbox.
+ *
+ * check() returns equal for OJ_ACCEPTED and error when the checker could
+ * not give a verdict; line and offset are not used.
+ */
+class SpecialChecker {
+  private:
+    std::string object;
+    bool isolated;
+
+    // In process
+    void *handle = nullptr;
+    int (*check_function)(const char *, size_t, const char *, size_t,
+                          const char *, size_t) = nullptr;
+
+    // Isolated: hosts not checking anything right now; a check owns its
+    // host alone while it runs
+    struct Host {
+        pid_t pid = -1;
+        int control = -1;
+    };
+    std::mutex host_mutex;
+    std::vector<Host> idle_hosts;
+
+    bool startHost(Host &host);
+    static void stopHost(Host &host);
+
+  public:
+    SpecialChecker(const std::string &object, bool isolated);
+    ~SpecialChecker();
+    SpecialChecker(const SpecialChecker &) = delete;
+    SpecialChecker &operator=(const SpecialChecker &) = delete;
+
+    // Loaded (in process) or loadable by a host (isolated)
+    bool ok() const;
+
+    CompareResult check(const std::string &input_file,
+                        const std::string &output_file,
+                        const std::string &answer_file);
+};
+
+// Compile `source` into a shared checker object (once per source content
+// and compiler) and return its path, or "" on a compile error
+std::string buildChecker(const std::string &source);
+
+// The checker built from `source`, whose content hashes to `source_hash`,
+// shared by all judge threads; nullptr if it does not build or load
+std::shared_ptr<SpecialChecker> specialChecker(const std::string &source,
+                                               uint64_t source_hash,
+                                               bool isolated);
+
+// Main loop of `OJ --checker-host <object> <fd>`: answer checks arriving on
+// socket `fd` until the judge closes it
+int runCheckerHost(const std::string &object, int fd);
+
+#endif // SPECIAL_CHECKER_H
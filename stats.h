@@ -0,0 +1,18 @@
+// stats.h
+#ifndef STATS_H
+#define STATS_H
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// Nearest-rank percentile (p in [0, 100]) of `samples`; 0 when empty
+inline double percentile(std::vector<double> samples, double p) {
+    if (samples.empty())
+        return 0;
+    std::sort(samples.begin(), samples.end());
+    size_t rank = (size_t)std::ceil(p / 100.0 * samples.size());
+    return samples[rank == 0 ? 0 : rank - 1];
+}
+
+#endif // STATS_H
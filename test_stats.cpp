@@ -0,0 +1,151 @@
+#include "test_stats.h"
+#include "problems.h"
+
+#include <algorithm>  // for stable_sort
+#include <filesystem> // for creating the parent directory
+#include <fstream>
+#include <numeric> // for iota
+
+#include <fcntl.h>    // for open
+#include <sys/file.h> // for flock
+#include <unistd.h>   // for getpid, close
+
+using namespace std;
+namespace fs = std::filesystem;
+
+// Tests cheaper than this are treated as costing this much, so timing noise
+// on tiny tests does not dominate the order
+const double MIN_COST_MS = 1.0;
+
+static string keyOf(const string &problem, const string &test) {
+    return problem + "/" + test;
+}
+
+void TestStats::record(const string &problem, const string &test,
+                       bool failed, long cpu_ms, uint64_t input_bytes) {
+    lock_guard<mutex> lock(stats_mutex);
+    for (Entry *entry : {&entries[keyOf(problem, test)],
+                         &unsaved[keyOf(problem, test)]}) {
+        entry->runs++;
+        if (failed)
+            entry->failures++;
+        entry->mean_cpu_ms += (cpu_ms - entry->mean_cpu_ms) / entry->runs;
+        entry->input_bytes = input_bytes;
+    }
+}
+
+double TestStats::meanCpuMs(const string &problem, const string &test) const {
+    lock_guard<mutex> lock(stats_mutex);
+    auto it = entries.find(keyOf(problem, test));
+    if (it == entries.end() || it->second.runs == 0)
+        return -1;
+    return it->second.mean_cpu_ms;
+}
+
+vector<size_t> TestStats::failFastOrder(const Problem &problem) const {
+    size_t n = problem.tests.size();
+    vector<Entry> known(n); // runs == 0 when the test has no history
+    // CPU time per input byte over the tests with a history, to guess the
+    // cost of the others from their size
+    double known_ms = 0, known_bytes = 0;
+    {
+        lock_guard<mutex> lock(stats_mutex);
+        for (size_t k = 0; k < n; k++) {
+            auto it = entries.find(keyOf(problem.name, problem.tests[k].name));
+            if (it == entries.end() || it->second.runs == 0)
+                continue;
+            known[k] = it->second;
+            known_ms += it->second.mean_cpu_ms;
+            known_bytes += (double)it->second.input_bytes;
+        }
+    }
+
+    vector<double> score(n);
+    for (size_t k = 0; k < n; k++) {
+        // Laplace's rule: a test never seen fails with probability 1/2
+        const Entry &entry = known[k];
+        double failure_rate = (entry.failures + 1.0) / (entry.runs + 2.0);
+        double cost = MIN_COST_MS;
+        if (entry.runs > 0)
+            cost = entry.mean_cpu_ms;
+        else if (known_bytes > 0)
+            cost = known_ms / known_bytes *
+                   (double)problem.tests[k].input_bytes;
+        score[k] = failure_rate / max(cost, MIN_COST_MS);
+    }
+
+    vector<size_t> order(n);
+    iota(order.begin(), order.end(), 0);
+    stable_sort(order.begin(), order.end(),
+                [&](size_t a, size_t b) { return score[a] > score[b]; });
+    return order;
+}
+
+void TestStats::load(const string &path) {
+    ifstream in(path);
+    string key;
+    Entry entry;
+    lock_guard<mutex> lock(stats_mutex);
+    while (in >> key >> entry.runs >> entry.failures >> entry.mean_cpu_ms >>
+           entry.input_bytes)
+        entries[key] = entry;
+}
+
+void TestStats::save(const string &path) {
+    lock_guard<mutex> lock(stats_mutex);
+    if (unsaved.empty())
+        return;
+    error_code ec;
+    fs::create_directories(fs::path(path).parent_path(), ec);
+    // One saver at a time, so no process's records are lost
+    int lock_fd = open((path + ".lock").c_str(), O_RDWR | O_CREAT | O_CLOEXEC,
+                       0644);
+    if (lock_fd >= 0)
+        flock(lock_fd, LOCK_EX);
+
+    map<string, Entry> merged;
+    {
+        ifstream in(path);
+        string key;
+        Entry entry;
+        while (in >> key >> entry.runs >> entry.failures >>
+               entry.mean_cpu_ms >> entry.input_bytes)
+            merged[key] = entry;
+    }
+    for (const auto &added : unsaved) {
+        Entry &entry = merged[added.first];
+        long runs = entry.runs + added.second.runs;
+        entry.mean_cpu_ms = (entry.mean_cpu_ms * entry.runs +
+                             added.second.mean_cpu_ms * added.second.runs) /
+                            runs;
+        entry.runs = runs;
+        entry.failures += added.second.failures;
+        entry.input_bytes = added.second.input_bytes;
+    }
+
+    string tmp = path + "." + to_string(getpid()) + ".tmp";
+    bool written;
+    {
+        ofstream out(tmp);
+        for (const auto &entry : merged)
+            out << entry.first << ' ' << entry.second.runs << ' '
+                << entry.second.failures << ' ' << entry.second.mean_cpu_ms
+                << ' ' << entry.second.input_bytes << '\n';
+        written = (bool)out.flush();
+    }
+    if (written)
+        fs::rename(tmp, path, ec);
+    if (!written || ec) {
+        fs::remove(tmp, ec);
+    } else {
+        entries = merged;
+        unsaved.clear();
+    }
+    if (lock_fd >= 0)
+        close(lock_fd); // releases the flock
+}
+
+TestStats &testStats() {
+    static TestStats stats;
+    return stats;
+}
@@ -0,0 +1,62 @@
+// test_stats.h
+#ifndef TEST_STATS_H
+#define TEST_STATS_H
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct Problem;
+
+/*
+ * History of every test of every problem: how often it ran, how often it
+ * failed, its mean CPU time and its input size. Kept per
+ * "<problem>/<test name>" and saved to a small text file between runs, like
+ * the CostModel.
+ *
+ * failFastOrder() turns it into a judging order for --order failfast: tests
+ * by descending failure rate per expected millisecond, which is the order
+ * that minimizes the expected time until a failing submission fails.
+ */
+class TestStats {
+  private:
+    struct Entry {
+        long runs = 0;
+        long failures = 0;
+        double mean_cpu_ms = 0;
+        uint64_t input_bytes = 0;
+    };
+
+    std::map<std::string, Entry> entries;
+    // What this process recorded since the last save, merged into the file
+    // by the next one
+    std::map<std::string, Entry> unsaved;
+    mutable std::mutex stats_mutex;
+
+  public:
+    void record(const std::string &problem, const std::string &test,
+                bool failed, long cpu_ms, uint64_t input_bytes);
+
+    // Mean CPU time of a test in ms, or -1 when it never ran
+    double meanCpuMs(const std::string &problem,
+                     const std::string &test) const;
+
+    // Positions into problem.tests, most likely to fail per unit of cost
+    // first; tests that compare equal keep their natural order
+    std::vector<size_t> failFastOrder(const Problem &problem) const;
+
+    // "<problem>/<test> <runs> <failures> <mean_cpu_ms> <input_bytes>" per
+    // line; missing files are not an error. save() adds what was recorded
+    // since the last save to the file as it is now, so processes sharing it
+    // (--workers) do not overwrite each other, and replaces it with rename()
+    // so a concurrent load never sees half of it.
+    void load(const std::string &path);
+    void save(const std::string &path);
+};
+
+// The statistics shared by all judge threads
+TestStats &testStats();
+
+#endif // TEST_STATS_H
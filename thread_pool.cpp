@@ -0,0 +1,266 @@
+#include "thread_pool.h"
+#include "metrics.h"
+
+#include <chrono>    // for busy time accounting
+#include <stdexcept> // for runtime_error
+#include <utility>   // for std::pair
+
+#include <pthread.h> // for pthread_setaffinity_np
+#include <sched.h>   // for cpu_set_t
+
+using namespace std;
+
+// The pool and deque index of the current worker thread, so a task that
+// submits more work keeps it on its own deque
+thread_local const ThreadPool *current_pool = nullptr;
+thread_local int current_worker = -1;
+
+void restrictToCpus(const vector<int> &cpus) {
+    if (cpus.empty())
+        return;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus)
+        CPU_SET(cpu, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
+
+vector<int> availableCpus() {
+    vector<int> cpus;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+            if (CPU_ISSET(cpu, &set))
+                cpus.push_back(cpu);
+    }
+    return cpus;
+}
+
+bool parsePolicy(const string &name, SchedulePolicy &policy) {
+    if (name == "fifo")
+        policy = SchedulePolicy::FIFO;
+    else if (name == "sjf")
+        policy = SchedulePolicy::SJF;
+    else if (name == "fair")
+        policy = SchedulePolicy::FAIR;
+    else
+        return false;
+    return true;
+}
+
+ThreadPool::ThreadPool(int num_threads, const vector<int> &cpus,
+                       SchedulePolicy policy, CostModel *costs, bool pin_each)
+    : policy(policy), costs(costs) {
+    // set up one deque per worker
+    for (int i = 0; i < num_threads; ++i)
+        queues.emplace_back(new WorkerQueue());
+
+    // Create the threads, add them to the list of threads
+    for (int i = 0; i < num_threads; i++) {
+        vector<int> worker_cpus = cpus;
+        if (pin_each && !cpus.empty())
+            worker_cpus = {cpus[i % cpus.size()]};
+        threads.emplace_back([this, i, worker_cpus] {
+            restrictToCpus(worker_cpus);
+            current_pool = this;
+            current_worker = i;
+            workerLoop(i);
+        });
+    }
+}
+
+void ThreadPool::workerLoop(int worker) {
+    while (true) {
+        Task task;
+        if (takeTask(worker, task)) {
+            runTask(task);
+
+            // The last task in flight wakes wait_idle()
+            if (--in_flight == 0) {
+                lock_guard<mutex> lock(idle_mutex);
+                idle_condition.notify_all();
+            }
+            continue;
+        }
+
+        // Nothing to run or steal: sleep until a task is queued, or the pool
+        // is stopped and drained
+        unique_lock<mutex> lock(sleep_mutex);
+        condition.wait(lock, [this] { return stop || queued > 0; });
+        if (stop && queued == 0)
+            return;
+    }
+}
+
+pair<double, uint64_t> schedulingScore(SchedulePolicy policy,
+                                       double expected_ms, uint64_t seq,
+                                       const string &group,
+                                       const map<string, double> &served) {
+    switch (policy) {
+    case SchedulePolicy::SJF:
+        return {expected_ms, seq};
+    case SchedulePolicy::FAIR: {
+        auto it = served.find(group);
+        return {it == served.end() ? 0 : it->second, seq};
+    }
+    default:
+        return {0, seq};
+    }
+}
+
+bool ThreadPool::takeTask(int worker, Task &task) {
+    map<string, double> served;
+    if (policy == SchedulePolicy::FAIR) {
+        lock_guard<mutex> lock(share_mutex);
+        served = served_ms;
+    }
+
+    // Best task of one deque, by the policy
+    auto best = [&](WorkerQueue &queue, pair<double, uint64_t> &score) {
+        int index = -1;
+        for (size_t k = 0; k < queue.tasks.size(); k++) {
+            const Task &t = queue.tasks[k];
+            auto s = schedulingScore(policy, t.expected_ms, t.seq,
+                                     t.info.group, served);
+            if (index < 0 || s < score) {
+                index = (int)k;
+                score = s;
+            }
+        }
+        return index;
+    };
+
+    auto take = [&](WorkerQueue &queue) {
+        lock_guard<mutex> lock(queue.queue_mutex);
+        pair<double, uint64_t> score;
+        int index = best(queue, score);
+        if (index < 0)
+            return false;
+        task = move(queue.tasks[index]);
+        queue.tasks.erase(queue.tasks.begin() + index);
+        queued--;
+        return true;
+    };
+
+    // Own deque first
+    if (take(*queues[worker]))
+        return true;
+
+    // Steal: look at every other deque and go for the best task among them
+    int victim = -1;
+    pair<double, uint64_t> victim_score;
+    for (size_t offset = 1; offset < queues.size(); offset++) {
+        int other = (worker + offset) % queues.size();
+        lock_guard<mutex> lock(queues[other]->queue_mutex);
+        pair<double, uint64_t> score;
+        if (best(*queues[other], score) >= 0 &&
+            (victim < 0 || score < victim_score)) {
+            victim = other;
+            victim_score = score;
+        }
+    }
+    // The victim may have been drained in between; the caller then retries
+    // or sleeps
+    return victim >= 0 && take(*queues[victim]);
+}
+
+void ThreadPool::runTask(Task &task) {
+    // Charge the expected cost up front so that concurrent FAIR picks see
+    // the group as busy, then correct it with the real duration
+    if (policy == SchedulePolicy::FAIR) {
+        lock_guard<mutex> lock(share_mutex);
+        served_ms[task.info.group] += task.expected_ms;
+    }
+
+    // Execute the task
+    auto start = chrono::steady_clock::now();
+    recordPhase(Phase::QUEUE_WAIT, chrono::duration_cast<chrono::microseconds>(
+                                       start - task.enqueued)
+                                       .count());
+    task.run();
+    auto duration = chrono::duration_cast<chrono::microseconds>(
+                        chrono::steady_clock::now() - start)
+                        .count();
+    busy_us += duration;
+
+    double duration_ms = duration / 1000.0;
+    if (policy == SchedulePolicy::FAIR) {
+        lock_guard<mutex> lock(share_mutex);
+        served_ms[task.info.group] += duration_ms - task.expected_ms;
+    }
+    if (costs) {
+        if (!task.info.cost_key.empty())
+            costs->record(task.info.cost_key, duration_ms);
+        if (!task.info.group.empty() && task.info.group != task.info.cost_key)
+            costs->record(task.info.group, duration_ms);
+    }
+}
+
+future<void> ThreadPool::add_task(function<void()> run,
+                                  const TaskInfo &info) {
+    // If the pool is stopped, throw an exception
+    if (stop)
+        throw runtime_error("ThreadPool is stopped");
+
+    auto done = make_shared<promise<void>>();
+    future<void> result = done->get_future();
+
+    Task task;
+    task.run = [run = move(run), done] {
+        try {
+            run();
+            done->set_value();
+        } catch (...) {
+            done->set_exception(current_exception());
+        }
+    };
+    task.info = info;
+    task.seq = next_seq++;
+    task.expected_ms = costs ? costs->expected(info.cost_key, info.group) : 0;
+    task.enqueued = chrono::steady_clock::now();
+
+    // Work submitted from one of our workers stays local, the rest is spread
+    // round-robin
+    int target = current_pool == this ? current_worker
+                                      : (int)(task.seq % queues.size());
+    in_flight++;
+    {
+        lock_guard<mutex> lock(queues[target]->queue_mutex);
+        queues[target]->tasks.push_back(move(task));
+        queued++;
+    }
+
+    // Taking sleep_mutex orders this with a worker that is about to wait,
+    // so the notification cannot be lost
+    { lock_guard<mutex> lock(sleep_mutex); }
+    condition.notify_one();
+    return result;
+}
+
+void ThreadPool::wait_idle() {
+    unique_lock<mutex> lock(idle_mutex);
+    idle_condition.wait(lock, [this] { return in_flight == 0; });
+}
+
+double ThreadPool::utilization(long long wall_us) const {
+    if (wall_us <= 0 || threads.empty())
+        return 0;
+    return (double)busy_us / ((double)wall_us * threads.size());
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        // Set the stop flag to true, meaning the pool is stopped
+        lock_guard<mutex> lock(sleep_mutex);
+        stop = true;
+    }
+
+    // Notify all threads to stop
+    condition.notify_all();
+
+    // Join all threads
+    for (thread &t : threads) {
+        t.join();
+    }
+}
@@ -0,0 +1,153 @@
+// thread_pool.h
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include "cost_model.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+ * Order in which queued tasks are picked:
+ *      FIFO - oldest task first
+ *      SJF  - shortest expected job first, from the pool's CostModel
+ *      FAIR - task of the group (problem) that has received the least
+ *             worker time so far, so one problem's burst cannot starve
+ *             the others
+ */
+enum class SchedulePolicy { FIFO, SJF, FAIR };
+
+// Parse "fifo", "sjf" or "fair"; returns false on anything else
+bool parsePolicy(const std::string &name, SchedulePolicy &policy);
+
+// Rank of a queued task under `policy`, lower is picked first: the policy's
+// key (expected duration for SJF, worker time `served` to the task's group
+// so far for FAIR), then submission order `seq`
+std::pair<double, uint64_t>
+schedulingScore(SchedulePolicy policy, double expected_ms, uint64_t seq,
+                const std::string &group,
+                const std::map<std::string, double> &served);
+
+/*
+ * What the scheduler knows about a task:
+ *      group    - fair-share unit, e.g. the problem
+ *      cost_key - key of the task's history in the CostModel, e.g. problem
+ *                 and source; when it has no history the group's is used
+ */
+struct TaskInfo {
+    std::string group;
+    std::string cost_key;
+};
+
+class ThreadPool {
+  private:
+    struct Task {
+        std::function<void()> run;
+        TaskInfo info;
+        uint64_t seq;         // submission order
+        double expected_ms;   // estimate at submission, for SJF
+        std::chrono::steady_clock::time_point enqueued;
+    };
+
+    // Every worker owns a deque; idle workers steal from the others
+    struct WorkerQueue {
+        std::mutex queue_mutex;
+        std::deque<Task> tasks;
+    };
+
+    // A list of threads in the pool
+    std::vector<std::thread> threads;
+    std::vector<std::unique_ptr<WorkerQueue>> queues;
+
+    SchedulePolicy policy;
+    CostModel *costs;
+
+    // Tasks sitting in any deque; workers sleep while it is 0
+    std::atomic<size_t> queued{0};
+    std::atomic<uint64_t> next_seq{0};
+
+    // Tasks submitted and not yet finished (queued or running). It goes up
+    // before a task is queued and down only after it has run, so it cannot
+    // read 0 while any task is in flight.
+    std::atomic<size_t> in_flight{0};
+    std::mutex idle_mutex;
+    std::condition_variable idle_condition;
+
+    // Mutex and condition variable for sleeping workers
+    std::mutex sleep_mutex;
+    std::condition_variable condition;
+
+    // A flag to stop the pool
+    std::atomic<bool> stop{false};
+
+    // Worker time handed to each group so far, for FAIR
+    std::mutex share_mutex;
+    std::map<std::string, double> served_ms;
+
+    // Total time the workers spent running tasks, for utilization reports
+    std::atomic<long long> busy_us{0};
+
+    void workerLoop(int worker);
+    bool takeTask(int worker, Task &task);
+    void runTask(Task &task);
+
+  public:
+    /*
+    Constructor:
+    - create a number of threads and add them to the pool, each thread
+    runs until the pool is stopped. A worker takes the best task of its own
+    deque according to `policy` and, when that is empty, steals from the
+    other workers' deques.
+    - `costs` (may be null) provides and collects job durations for SJF
+    - if `cpus` is not empty, every worker (and so every process it
+    starts) is restricted to those CPUs; with `pin_each`, worker i gets
+    cpus[i % cpus.size()] alone, so its runs do not migrate between cores
+    or share one with another worker (as long as there are enough CPUs)
+    */
+    ThreadPool(int num_threads, const std::vector<int> &cpus = {},
+               SchedulePolicy policy = SchedulePolicy::FIFO,
+               CostModel *costs = nullptr, bool pin_each = false);
+
+    /*
+     * add_task function: add a task (function) to one of the deques. The
+     * future becomes ready when the task has run (and carries its exception,
+     * if it threw).
+     */
+    std::future<void> add_task(std::function<void()> task,
+                               const TaskInfo &info = {});
+
+    // Block until every submitted task has finished, including tasks that
+    // running tasks submit to this pool
+    void wait_idle();
+
+    int num_workers() const { return (int)threads.size(); }
+
+    // Fraction of the workers' capacity spent on tasks over `wall_us`
+    double utilization(long long wall_us) const;
+
+    /*
+    Destructor: wait for all threads to finish executing their tasks
+    then join the threads and exit the program
+    */
+    ~ThreadPool();
+};
+
+// CPUs this process may run on, in ascending order
+std::vector<int> availableCpus();
+
+// Restrict the calling thread (and processes it starts later) to `cpus`;
+// does nothing if `cpus` is empty
+void restrictToCpus(const std::vector<int> &cpus);
+
+#endif // THREAD_POOL_H
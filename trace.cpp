@@ -0,0 +1,117 @@
+#include "trace.h"
+
+#include <fstream>
+#include <memory> // for unique_ptr
+#include <mutex>
+#include <vector>
+
+#include <sys/syscall.h> // for SYS_gettid
+#include <unistd.h>      // for getpid, syscall
+
+using namespace std;
+
+struct TraceEvent {
+    const char *name;
+    char phase;       // 'X' complete span, 'b'/'e' async begin/end
+    long long ts_us;  // since startTrace()
+    long long dur_us; // 'X' only
+    int task_id;
+    int index;
+};
+
+// Events of one thread. Only the owning thread appends; writeTrace() reads
+// them after the judging threads are done.
+struct ThreadTrace {
+    long tid;
+    vector<TraceEvent> events;
+};
+
+static bool enabled = false;
+static TraceClock::time_point trace_start;
+
+static mutex buffers_mutex;
+static vector<unique_ptr<ThreadTrace>> buffers; // of every traced thread
+
+// The calling thread's buffer, registered on its first event. Buffers belong
+// to the list, so events of threads that have exited are still written.
+static ThreadTrace &localTrace() {
+    thread_local ThreadTrace *trace = nullptr;
+    if (!trace) {
+        unique_ptr<ThreadTrace> buffer(new ThreadTrace());
+        buffer->tid = syscall(SYS_gettid);
+        buffer->events.reserve(1024);
+        trace = buffer.get();
+        lock_guard<mutex> lock(buffers_mutex);
+        buffers.push_back(move(buffer));
+    }
+    return *trace;
+}
+
+static long long sinceStart(TraceClock::time_point t) {
+    return chrono::duration_cast<chrono::microseconds>(t - trace_start)
+        .count();
+}
+
+void startTrace() {
+    trace_start = TraceClock::now();
+    enabled = true;
+}
+
+bool tracing() { return enabled; }
+
+TraceSpan::TraceSpan(const char *name, int task_id, int index)
+    : name(name), task_id(task_id), index(index) {
+    if (enabled)
+        start = TraceClock::now();
+}
+
+TraceSpan::~TraceSpan() {
+    if (!enabled)
+        return;
+    long long begin = sinceStart(start);
+    long long end = sinceStart(TraceClock::now());
+    localTrace().events.push_back(
+        {name, 'X', begin, end - begin, task_id, index});
+}
+
+void traceAsync(const char *name, int task_id, TraceClock::time_point begin,
+                TraceClock::time_point end) {
+    if (!enabled)
+        return;
+    ThreadTrace &trace = localTrace();
+    trace.events.push_back({name, 'b', sinceStart(begin), 0, task_id, -1});
+    trace.events.push_back({name, 'e', sinceStart(end), 0, task_id, -1});
+}
+
+bool writeTrace(const string &path) {
+    ofstream out(path);
+    if (!out)
+        return false;
+    int pid = getpid();
+    lock_guard<mutex> lock(buffers_mutex);
+    out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+    bool first = true;
+    for (const auto &buffer : buffers) {
+        out << (first ? "" : ",\n") << "{\"name\": \"thread_name\", "
+            << "\"ph\": \"M\", \"pid\": " << pid << ", \"tid\": "
+            << buffer->tid << ", \"args\": {\"name\": \"thread "
+            << buffer->tid << "\"}}";
+        first = false;
+        for (const TraceEvent &event : buffer->events) {
+            out << ",\n{\"name\": \"" << event.name;
+            if (event.index >= 0)
+                out << ' ' << event.index;
+            out << "\", \"ph\": \"" << event.phase << "\", \"ts\": "
+                << event.ts_us << ", \"pid\": " << pid << ", \"tid\": "
+                << buffer->tid;
+            if (event.phase == 'X')
+                out << ", \"cat\": \"judge\", \"dur\": " << event.dur_us;
+            else
+                out << ", \"cat\": \"submission\", \"id\": " << event.task_id;
+            out << ", \"args\": {\"task\": " << event.task_id
+                << ", \"thread\": " << buffer->tid << "}}";
+        }
+    }
+    out << "\n]}\n";
+    return (bool)out;
+}
@@ -0,0 +1,50 @@
+// trace.h
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <chrono>
+#include <string>
+
+/*
+ * Timeline of the judge in the Chrome trace-event format, for
+ * chrome://tracing or ui.perfetto.dev.
+ *
+ * Every thread appends its events to its own buffer, so recording takes no
+ * lock and never waits for another thread; the buffers are only read by
+ * writeTrace(), once judging is over. Spans on a thread are "complete"
+ * events tagged with the task id; submission-wide spans that are not tied
+ * to one thread (queued, the whole submission) are async events keyed by
+ * the task id.
+ *
+ * Span names must be string literals (or otherwise outlive the trace).
+ */
+
+typedef std::chrono::steady_clock TraceClock;
+
+// Start recording; call before any judging thread starts. Without it every
+// trace call returns at once.
+void startTrace();
+bool tracing();
+
+// One span on the calling thread, from construction to destruction, named
+// `name` or "<name> <index>" when index >= 0
+class TraceSpan {
+  private:
+    const char *name;
+    int task_id;
+    int index;
+    TraceClock::time_point start;
+
+  public:
+    TraceSpan(const char *name, int task_id, int index = -1);
+    ~TraceSpan();
+};
+
+// Span of submission `task_id` between two points in time
+void traceAsync(const char *name, int task_id, TraceClock::time_point begin,
+                TraceClock::time_point end);
+
+// Write every thread's events to `path`; false if it cannot be written
+bool writeTrace(const std::string &path);
+
+#endif // TRACE_H
@@ -0,0 +1,210 @@
+#include "verdict_cache.h"
+#include "checker.h"
+#include "hashing.h"
+
+#include <algorithm> // for nth_element
+#include <filesystem>
+#include <fstream>
+#include <iterator> // for next
+#include <sstream>
+
+#include <fcntl.h>
+#include <sys/stat.h> // for noticing a compacted results file
+#include <unistd.h>
+
+using namespace std;
+namespace fs = std::filesystem;
+
+const string VERDICT_CACHE_FILE = ".oj_cache/verdicts.txt";
+const string SUBMISSIONS_FILE = ".oj_cache/submissions.txt";
+// The results file is compacted past this size, down to this many results
+const size_t VERDICT_CACHE_MAX_BYTES = 64ul << 20;
+const size_t VERDICT_CACHE_MAX_ENTRIES = 500000;
+
+string testKey(const string &binary_digest, uint64_t input_hash,
+               uint64_t expected_hash, int time_limit_ms,
+               long memory_limit_bytes, long output_limit_bytes,
+               const string &checker) {
+    ostringstream key;
+    key << binary_digest << ' ' << input_hash << ' ' << expected_hash << ' '
+        << time_limit_ms << ' ' << memory_limit_bytes << ' '
+        << output_limit_bytes << ' ' << checker;
+    return sha256Hex(key.str());
+}
+
+string fileDigest(const string &path) {
+    MappedFile file(path);
+    return file.ok ? sha256Hex(file.data, file.size) : "";
+}
+
+// One line per write(), so lines from concurrent processes do not mix
+static void appendLine(int fd, const string &line) {
+    if (fd < 0)
+        return;
+    ssize_t written = write(fd, line.data(), line.size());
+    (void)written;
+}
+
+static int openAppend(const string &path) {
+    error_code ec;
+    fs::create_directories(fs::path(path).parent_path(), ec);
+    return open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC,
+                0644);
+}
+
+VerdictCache::VerdictCache(const string &results_path,
+                           const string &submissions_path, size_t max_bytes,
+                           size_t max_entries)
+    : results_path(results_path), submissions_path(submissions_path),
+      max_bytes(max_bytes), max_entries(max_entries) {}
+
+VerdictCache::~VerdictCache() {
+    for (int fd : {results_fd, submissions_fd})
+        if (fd >= 0)
+            close(fd);
+}
+
+// Read both files on first use, then keep appending to them
+void VerdictCache::load() {
+    if (loaded)
+        return;
+    loaded = true;
+
+    ifstream in(results_path);
+    string line;
+    while (getline(in, line)) {
+        istringstream fields(line);
+        string key;
+        CachedTest test;
+        if (fields >> key >> test.verdict >> test.wall_ms >>
+            test.cpu_ms >> test.peak_rss_kb >> test.diff_line >>
+            test.diff_offset)
+            results[key] = {test, ++uses};
+        results_bytes += line.size() + 1;
+    }
+
+    ifstream index(submissions_path);
+    while (getline(index, line)) {
+        size_t tab = line.find('\t');
+        if (tab != string::npos)
+            submissions.insert({line.substr(0, tab), line.substr(tab + 1)});
+    }
+
+    results_fd = openAppend(results_path);
+    submissions_fd = openAppend(submissions_path);
+}
+
+static string resultLine(const string &key, const CachedTest &test) {
+    ostringstream line;
+    line << key << ' ' << test.verdict << ' ' << test.wall_ms
+         << ' ' << test.cpu_ms << ' ' << test.peak_rss_kb << ' '
+         << test.diff_line << ' ' << test.diff_offset << '\n';
+    return line.str();
+}
+
+// Whether `fd` is still the file at `path`, i.e. no one compacted it
+static bool isCurrent(int fd, const string &path) {
+    struct stat open_file, named_file;
+    return fstat(fd, &open_file) == 0 && stat(path.c_str(), &named_file) == 0 &&
+           open_file.st_ino == named_file.st_ino &&
+           open_file.st_dev == named_file.st_dev;
+}
+
+// Caller holds cache_mutex
+void VerdictCache::appendResult(const string &line) {
+    if (results_fd >= 0 && !isCurrent(results_fd, results_path)) {
+        // Another process compacted the file: append to the new one
+        close(results_fd);
+        results_fd = openAppend(results_path);
+        struct stat st;
+        results_bytes = fstat(results_fd, &st) == 0 ? (size_t)st.st_size : 0;
+    }
+    appendLine(results_fd, line);
+    results_bytes += line.size();
+    if (results_bytes > max_bytes)
+        compact();
+}
+
+// Caller holds cache_mutex. Results written meanwhile by other processes
+// and not seen by this one are lost, which only costs a rerun.
+void VerdictCache::compact() {
+    if (results.size() > max_entries) {
+        vector<uint64_t> stamps;
+        for (const auto &result : results)
+            stamps.push_back(result.second.used);
+        // Keep the max_entries newest
+        nth_element(stamps.begin(), stamps.end() - max_entries, stamps.end());
+        uint64_t oldest_kept = *(stamps.end() - max_entries);
+        for (auto it = results.begin(); it != results.end();)
+            it = it->second.used < oldest_kept ? results.erase(it) : next(it);
+    }
+
+    string tmp = results_path + "." + to_string(getpid()) + ".tmp";
+    string contents;
+    for (const auto &result : results)
+        contents += resultLine(result.first, result.second.test);
+    {
+        ofstream out(tmp, ios::binary | ios::trunc);
+        out << contents;
+        if (!out)
+            return;
+    }
+    error_code ec;
+    fs::rename(tmp, results_path, ec);
+    if (ec) {
+        fs::remove(tmp, ec);
+        return;
+    }
+    if (results_fd >= 0)
+        close(results_fd);
+    results_fd = openAppend(results_path);
+    results_bytes = contents.size();
+}
+
+bool VerdictCache::lookup(const string &key, CachedTest &test) {
+    lock_guard<mutex> lock(cache_mutex);
+    load();
+    auto it = results.find(key);
+    if (it == results.end())
+        return false;
+    it->second.used = ++uses;
+    test = it->second.test;
+    return true;
+}
+
+void VerdictCache::store(const string &key, const CachedTest &test) {
+    lock_guard<mutex> lock(cache_mutex);
+    load();
+    Entry &entry = results[key];
+    bool unchanged = entry.used != 0 && entry.test.sameOutcome(test);
+    entry.used = ++uses;
+    if (unchanged)
+        return;
+    entry.test = test;
+    appendResult(resultLine(key, test));
+}
+
+void VerdictCache::recordSubmission(const string &problem,
+                                    const string &source) {
+    lock_guard<mutex> lock(cache_mutex);
+    load();
+    if (submissions.insert({problem, source}).second)
+        appendLine(submissions_fd, problem + '\t' + source + '\n');
+}
+
+vector<string> VerdictCache::submissionsOf(const string &problem) {
+    lock_guard<mutex> lock(cache_mutex);
+    load();
+    vector<string> sources;
+    for (auto it = submissions.lower_bound({problem, ""});
+         it != submissions.end() && it->first == problem; ++it)
+        sources.push_back(it->second);
+    return sources;
+}
+
+VerdictCache &verdictCache() {
+    static VerdictCache cache(VERDICT_CACHE_FILE, SUBMISSIONS_FILE,
+                              VERDICT_CACHE_MAX_BYTES,
+                              VERDICT_CACHE_MAX_ENTRIES);
+    return cache;
+}
@@ -0,0 +1,105 @@
+// verdict_cache.h
+#ifndef VERDICT_CACHE_H
+#define VERDICT_CACHE_H
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+/*
+ * Outcome of one test as remembered by the verdict cache: the test's
+ * verdict with its time, CPU time and peak memory, and for a WA the line and
+ * byte offset of the first difference.
+ */
+struct CachedTest {
+    std::string verdict;
+    long wall_ms = 0;
+    long cpu_ms = 0;
+    long peak_rss_kb = 0;
+    size_t diff_line = 1;
+    size_t diff_offset = 0;
+
+    // Same verdict and first difference; times and memory vary run to run
+    bool sameOutcome(const CachedTest &other) const {
+        return verdict == other.verdict && diff_line == other.diff_line &&
+               diff_offset == other.diff_offset;
+    }
+};
+
+/*
+ * Per-test results keyed by everything the result depends on (see testKey),
+ * plus the list of submissions judged per problem, both kept in append-only
+ * files under .oj_cache/ so a later `OJ --rejudge <problem>` can reuse them.
+ * Every judge process appends to the same files with single O_APPEND
+ * writes; on load, the last line for a key wins.
+ *
+ * Every finished test is recorded; results are only reused when a judge
+ * asks for them (lookup), which the rejudge mode does. A result with the
+ * same outcome as the recorded one is not appended again. Once the results file
+ * grows past max_bytes it is rewritten with one line per key, keeping the
+ * max_entries most recently used ones, and atomically renamed into place;
+ * processes still appending to the old file notice and reopen it.
+ */
+class VerdictCache {
+  private:
+    struct Entry {
+        CachedTest test;
+        uint64_t used = 0; // when last stored or looked up, counting `uses`
+    };
+
+    std::string results_path;
+    std::string submissions_path;
+    size_t max_bytes;
+    size_t max_entries;
+    int results_fd = -1;
+    int submissions_fd = -1;
+    bool loaded = false;
+    size_t results_bytes = 0; // size of the results file
+    uint64_t uses = 0;
+
+    std::map<std::string, Entry> results; // by testKey()
+    std::set<std::pair<std::string, std::string>> submissions;
+    std::mutex cache_mutex;
+
+    // Caller holds cache_mutex
+    void load();
+    void appendResult(const std::string &line);
+    void compact();
+
+  public:
+    VerdictCache(const std::string &results_path,
+                 const std::string &submissions_path, size_t max_bytes,
+                 size_t max_entries);
+    ~VerdictCache();
+    VerdictCache(const VerdictCache &) = delete;
+    VerdictCache &operator=(const VerdictCache &) = delete;
+
+    bool lookup(const std::string &key, CachedTest &test);
+    void store(const std::string &key, const CachedTest &test);
+
+    // Remember that `source` was judged against `problem`
+    void recordSubmission(const std::string &problem,
+                          const std::string &source);
+    // Sources ever judged against `problem`, in name order
+    std::vector<std::string> submissionsOf(const std::string &problem);
+};
+
+// The cache shared by all judge threads
+VerdictCache &verdictCache();
+
+// Key of one test result: the binary that ran (its fileDigest), the input
+// and expected output (content hashes), and the limits and checker it was
+// judged under, as a SHA-256, since participants control the binary
+std::string testKey(const std::string &binary_digest, uint64_t input_hash,
+                    uint64_t expected_hash, int time_limit_ms,
+                    long memory_limit_bytes, long output_limit_bytes,
+                    const std::string &checker);
+
+// SHA-256 of a whole file (e.g. a compiled binary), "" if it cannot be read
+std::string fileDigest(const std::string &path);
+
+#endif // VERDICT_CACHE_H
@@ -0,0 +1,181 @@
+#include "wire.h"
+#include "result_log.h"
+
+#include <cerrno>
+
+#include <sys/socket.h>
+#include <unistd.h> // for read
+
+using namespace std;
+
+void WireWriter::u32(uint32_t value) {
+    for (int i = 0; i < 4; i++)
+        bytes += (char)(value >> (8 * i));
+}
+
+void WireWriter::u64(uint64_t value) {
+    for (int i = 0; i < 8; i++)
+        bytes += (char)(value >> (8 * i));
+}
+
+void WireWriter::str(const string &value) {
+    u32((uint32_t)value.size());
+    bytes += value;
+}
+
+bool WireReader::need(size_t n) {
+    if (!good || bytes.size() - at < n)
+        good = false;
+    return good;
+}
+
+uint8_t WireReader::u8() {
+    return need(1) ? (uint8_t)bytes[at++] : 0;
+}
+
+uint32_t WireReader::u32() {
+    if (!need(4))
+        return 0;
+    uint32_t value = 0;
+    for (int i = 0; i < 4; i++)
+        value |= (uint32_t)(unsigned char)bytes[at++] << (8 * i);
+    return value;
+}
+
+uint64_t WireReader::u64() {
+    if (!need(8))
+        return 0;
+    uint64_t value = 0;
+    for (int i = 0; i < 8; i++)
+        value |= (uint64_t)(unsigned char)bytes[at++] << (8 * i);
+    return value;
+}
+
+string WireReader::str() {
+    uint32_t size = u32();
+    if (!need(size))
+        return "";
+    string value = bytes.substr(at, size);
+    at += size;
+    return value;
+}
+
+void encodeRecord(WireWriter &out, const ResultRecord &record) {
+    out.u32((uint32_t)record.task_id);
+    out.str(record.problem);
+    out.str(record.verdict);
+    out.i64(record.failing_test);
+    out.i64(record.diff_line);
+    out.i64(record.diff_offset);
+    out.i64(record.wall_ms);
+    out.i64(record.cpu_ms);
+    out.i64(record.peak_rss_kb);
+    out.u64(record.judge_id);
+    out.str(record.order);
+    out.u32((uint32_t)record.tests.size());
+    for (const TestRecord &test : record.tests) {
+        out.str(test.name);
+        out.str(test.verdict);
+        out.i64(test.wall_ms);
+        out.i64(test.cpu_ms);
+        out.i64(test.peak_rss_kb);
+    }
+}
+
+bool decodeRecord(WireReader &in, ResultRecord &record) {
+    record.task_id = (int)in.u32();
+    record.problem = in.str();
+    record.verdict = in.str();
+    record.failing_test = (int)in.i64();
+    record.diff_line = (long)in.i64();
+    record.diff_offset = (long)in.i64();
+    record.wall_ms = (long)in.i64();
+    record.cpu_ms = (long)in.i64();
+    record.peak_rss_kb = (long)in.i64();
+    record.judge_id = (size_t)in.u64();
+    record.order = in.str();
+    uint32_t num_tests = in.u32();
+    record.tests.clear();
+    for (uint32_t k = 0; k < num_tests && in.ok(); k++) {
+        TestRecord test;
+        test.name = in.str();
+        test.verdict = in.str();
+        test.wall_ms = (long)in.i64();
+        test.cpu_ms = (long)in.i64();
+        test.peak_rss_kb = (long)in.i64();
+        record.tests.push_back(test);
+    }
+    return in.ok();
+}
+
+static string frameHeader(MessageType type, size_t payload_size) {
+    WireWriter header;
+    header.u32((uint32_t)(payload_size + 1));
+    header.u8((uint8_t)type);
+    return header.payload();
+}
+
+string encodeMessage(MessageType type, const string &payload) {
+    return frameHeader(type, payload.size()) + payload;
+}
+
+bool sendMessage(int fd, MessageType type, const string &payload) {
+    string frame = encodeMessage(type, payload);
+    size_t sent = 0;
+    while (sent < frame.size()) {
+        ssize_t n = send(fd, frame.data() + sent, frame.size() - sent,
+                         MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        sent += n;
+    }
+    return true;
+}
+
+static bool readFully(int fd, char *data, size_t size) {
+    size_t got = 0;
+    while (got < size) {
+        ssize_t n = read(fd, data + got, size - got);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        got += n;
+    }
+    return true;
+}
+
+bool readMessage(int fd, MessageType &type, string &payload) {
+    string header(4, '\0');
+    if (!readFully(fd, &header[0], 4))
+        return false;
+    uint32_t length = WireReader(header).u32();
+    if (length == 0 || length > MAX_FRAME_BYTES)
+        return false;
+    string frame(length, '\0');
+    if (!readFully(fd, &frame[0], length))
+        return false;
+    type = (MessageType)frame[0];
+    payload = frame.substr(1);
+    return true;
+}
+
+bool takeMessage(string &buffer, MessageType &type, string &payload,
+                 bool &broken) {
+    broken = false;
+    if (buffer.size() < 4)
+        return false;
+    uint32_t length = WireReader(buffer).u32();
+    if (length == 0 || length > MAX_FRAME_BYTES) {
+        broken = true;
+        return false;
+    }
+    if (buffer.size() - 4 < length)
+        return false;
+    type = (MessageType)buffer[4];
+    payload = buffer.substr(5, length - 1);
+    buffer.erase(0, 4 + length);
+    return true;
+}
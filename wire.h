@@ -0,0 +1,80 @@
+// wire.h
+#ifndef WIRE_H
+#define WIRE_H
+
+#include <cstdint>
+#include <string>
+
+struct ResultRecord;
+
+/*
+ * Coordinator <-> worker protocol. Every message is a frame:
+ *      u32 length | u8 type | payload (length - 1 bytes)
+ * Integers are little-endian whatever the host, strings are a u32 length
+ * followed by the bytes, so a worker may run on another machine.
+ *
+ *      HELLO      worker -> coordinator   u32 capacity, u32 pid
+ *      JOB        coordinator -> worker   u32 task id, str problem, str source
+ *      RESULT     worker -> coordinator   an encoded ResultRecord
+ *      HEARTBEAT  worker -> coordinator   (empty), every HEARTBEAT_MS
+ */
+enum class MessageType : uint8_t { HELLO = 1, JOB, RESULT, HEARTBEAT };
+
+const int HEARTBEAT_MS = 500;
+// Frames larger than this are treated as a broken peer
+const uint32_t MAX_FRAME_BYTES = 16u << 20;
+
+class WireWriter {
+  private:
+    std::string bytes;
+
+  public:
+    void u8(uint8_t value) { bytes += (char)value; }
+    void u32(uint32_t value);
+    void u64(uint64_t value);
+    void i64(int64_t value) { u64((uint64_t)value); }
+    void str(const std::string &value);
+
+    const std::string &payload() const { return bytes; }
+};
+
+// Reads a payload; any read past the end marks it bad and returns 0/""
+class WireReader {
+  private:
+    const std::string &bytes;
+    size_t at = 0;
+    bool good = true;
+
+    bool need(size_t n);
+
+  public:
+    explicit WireReader(const std::string &payload) : bytes(payload) {}
+
+    uint8_t u8();
+    uint32_t u32();
+    uint64_t u64();
+    int64_t i64() { return (int64_t)u64(); }
+    std::string str();
+
+    bool ok() const { return good; }
+};
+
+void encodeRecord(WireWriter &out, const ResultRecord &record);
+bool decodeRecord(WireReader &in, ResultRecord &record);
+
+// The bytes of one whole frame, for writers that queue them
+std::string encodeMessage(MessageType type, const std::string &payload);
+
+// Write one whole frame to a blocking socket; false if the peer is gone
+bool sendMessage(int fd, MessageType type, const std::string &payload);
+
+// Read one whole frame from a blocking socket; false on EOF or error
+bool readMessage(int fd, MessageType &type, std::string &payload);
+
+// Take one frame off the front of `buffer` (bytes received so far, for
+// non-blocking readers). Returns false while the frame is incomplete; sets
+// `broken` if the buffer cannot be a valid frame.
+bool takeMessage(std::string &buffer, MessageType &type, std::string &payload,
+                 bool &broken);
+
+#endif // WIRE_H
@@ -0,0 +1,125 @@
+#include "worker.h"
+#include "judger.h"
+#include "result_log.h"
+#include "thread_pool.h"
+#include "wire.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstring> // for strcpy
+#include <filesystem>
+#include <iostream>
+#include <mutex>
+#include <thread>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace std;
+namespace fs = std::filesystem;
+
+// How long a worker keeps trying to reach a coordinator that is starting up
+const int CONNECT_ATTEMPTS = 50;
+const int CONNECT_RETRY_MS = 100;
+
+static int connectTo(const string &socket_path) {
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if (socket_path.size() >= sizeof(address.sun_path))
+        return -1;
+    strcpy(address.sun_path, socket_path.c_str());
+    for (int attempt = 0; attempt < CONNECT_ATTEMPTS; attempt++) {
+        int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0)
+            return -1;
+        if (connect(fd, (sockaddr *)&address, sizeof(address)) == 0)
+            return fd;
+        close(fd);
+        this_thread::sleep_for(chrono::milliseconds(CONNECT_RETRY_MS));
+    }
+    return -1;
+}
+
+string workerScratchDir(pid_t pid) {
+    return ".oj_work/worker" + to_string(pid);
+}
+
+int runWorker(const string &socket_path, int threads) {
+    int fd = connectTo(socket_path);
+    if (fd < 0) {
+        cerr << "Worker cannot reach coordinator at " << socket_path << '\n';
+        return 1;
+    }
+
+    SCRATCH_DIR = workerScratchDir(getpid());
+    fs::create_directories(SCRATCH_DIR);
+
+    // Results, heartbeats and HELLO share the socket
+    mutex send_mutex;
+    auto sendLocked = [&](MessageType type, const string &payload) {
+        lock_guard<mutex> lock(send_mutex);
+        return sendMessage(fd, type, payload);
+    };
+
+    // Verdicts go back to the coordinator, which prints them
+    resultLog().setBanners(false);
+    resultLog().setListener([&](const ResultRecord &record) {
+        WireWriter out;
+        encodeRecord(out, record);
+        sendLocked(MessageType::RESULT, out.payload());
+    });
+
+    // Heartbeats come from their own thread, so a long run does not make
+    // the worker look dead
+    mutex stop_mutex;
+    condition_variable stop_condition;
+    bool stop = false;
+    thread heartbeat([&] {
+        unique_lock<mutex> lock(stop_mutex);
+        while (!stop_condition.wait_for(lock,
+                                        chrono::milliseconds(HEARTBEAT_MS),
+                                        [&] { return stop; }))
+            if (!sendLocked(MessageType::HEARTBEAT, ""))
+                return;
+    });
+
+    {
+        ThreadPool pool(threads);
+        WireWriter hello;
+        hello.u32((uint32_t)threads);
+        hello.u32((uint32_t)getpid());
+        sendLocked(MessageType::HELLO, hello.payload());
+
+        MessageType type;
+        string payload;
+        while (readMessage(fd, type, payload)) {
+            if (type != MessageType::JOB)
+                continue;
+            WireReader in(payload);
+            int task_id = (int)in.u32();
+            string problem = in.str();
+            string source = in.str();
+            if (!in.ok())
+                break;
+            TaskInfo info = {problem, problem + ":" + source};
+            pool.add_task([=] { judge(task_id, source, problem); }, info);
+        }
+        // The coordinator is gone: finish what we have, nobody takes more
+        pool.wait_idle();
+    }
+
+    {
+        lock_guard<mutex> lock(stop_mutex);
+        stop = true;
+    }
+    stop_condition.notify_all();
+    heartbeat.join();
+    resultLog().close();
+    resultLog().setListener(nullptr);
+    close(fd);
+
+    error_code ec;
+    fs::remove_all(SCRATCH_DIR, ec);
+    return 0;
+}
@@ -0,0 +1,25 @@
+// worker.h
+#ifndef WORKER_H
+#define WORKER_H
+
+#include <string>
+
+#include <sys/types.h> // for pid_t
+
+/*
+ * Judge worker process (`OJ --worker <socket>`): connects to the
+ * coordinator at `socket_path`, announces `threads` slots and judges the
+ * jobs it is sent on that many threads, reporting each verdict back and
+ * sending a heartbeat every HEARTBEAT_MS in between. Executables and
+ * outputs live in a scratch directory of its own, .oj_work/worker<pid>,
+ * removed on exit.
+ *
+ * Returns (with the exit status for main) once the coordinator closes the
+ * connection and the jobs in hand are done.
+ */
+int runWorker(const std::string &socket_path, int threads);
+
+// Scratch directory of the worker process `pid`
+std::string workerScratchDir(pid_t pid);
+
+#endif // WORKER_H